@@ -0,0 +1,365 @@
+#ifndef BATCH_GAME_HPP
+#define BATCH_GAME_HPP
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "game.hpp"
+#include "rng.hpp"
+
+// pads a row table by a row so that a 32-bit gather of the last row doesn't read past the end of the array
+TABLE_GENERATOR std::array<row_t, ROWS + 2> pad_row_table(const std::array<row_t, ROWS>& row_table) {
+    std::array<row_t, ROWS + 2> padded{};
+    for (int row = 0; row < ROWS; ++row) padded[row] = row_table[row];
+    return padded;
+}
+
+// plays many independent games in lockstep, one game per lane
+// every step makes all four moves for every lane at once, which gives each lane's legal moves for free
+// the move kernels use AVX-512 or AVX2 gathers when the compiler is allowed to, and fall back to scalar code otherwise
+// finished games are replaced by new ones, and once there aren't any games left the batch is compacted
+// so that the remaining games never have to wait for lanes that are already done
+template<int LANES = 32>
+class BatchGameSimulator {
+    static_assert(8 <= LANES && LANES <= 64 && LANES % 8 == 0, "lane count must be a multiple of the vector width");
+
+    static constexpr int VECTOR_WIDTH = 8;  // boards per AVX-512 register; AVX2 handles half of this at a time
+
+    alignas(64) static LOOKUP_TABLE std::array<row_t, ROWS + 2> row_left = pad_row_table(GameSimulator::row_left);
+    alignas(64) static LOOKUP_TABLE std::array<row_t, ROWS + 2> row_right = pad_row_table(GameSimulator::row_right);
+
+    alignas(64) board_t boards[LANES];
+    alignas(64) board_t next[4][LANES];  // result of each move for each lane
+    uint64_t legal[4];  // bitmask of which lanes can make each move
+    rng_t spawn_rng[LANES];  // each game's own tiles, like GameSimulator::spawn_rng
+    int game_idx[LANES];
+    int fours[LANES];
+    int active = 0;  // lanes [0, active) are playing; everything else is finished
+
+    const uint64_t run_seed;
+    const int first_game;  // index of this simulator's first game within the whole run
+
+#if defined(__AVX512F__)
+    static __m512i transpose_vec(const __m512i b) {
+        const __m512i a = _mm512_or_si512(
+                _mm512_or_si512(_mm512_slli_epi64(_mm512_and_si512(b, _mm512_set1_epi64(0x0000F0F00000F0F0LL)), 12),
+                                _mm512_and_si512(b, _mm512_set1_epi64(0xF0F00F0FF0F00F0FLL))),
+                _mm512_srli_epi64(_mm512_and_si512(b, _mm512_set1_epi64(0x0F0F00000F0F0000LL)), 12));
+        return _mm512_or_si512(
+                _mm512_or_si512(_mm512_slli_epi64(_mm512_and_si512(a, _mm512_set1_epi64(0x00000000FF00FF00LL)), 24),
+                                _mm512_and_si512(a, _mm512_set1_epi64(0xFF00FF0000FF00FFLL))),
+                _mm512_srli_epi64(_mm512_and_si512(a, _mm512_set1_epi64(0x00FF00FF00000000LL)), 24));
+    }
+#elif defined(__AVX2__)
+    static __m256i transpose_vec(const __m256i b) {
+        const __m256i a = _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(b, _mm256_set1_epi64x(0x0000F0F00000F0F0LL)), 12),
+                                _mm256_and_si256(b, _mm256_set1_epi64x(0xF0F00F0FF0F00F0FLL))),
+                _mm256_srli_epi64(_mm256_and_si256(b, _mm256_set1_epi64x(0x0F0F00000F0F0000LL)), 12));
+        return _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(a, _mm256_set1_epi64x(0x00000000FF00FF00LL)), 24),
+                                _mm256_and_si256(a, _mm256_set1_epi64x(0xFF00FF0000FF00FFLL))),
+                _mm256_srli_epi64(_mm256_and_si256(a, _mm256_set1_epi64x(0x00FF00FF00000000LL)), 24));
+    }
+#endif
+
+    // transposes the first n boards from one array into another, which can be the same array
+    static void transpose_boards(board_t* out, const board_t* in, const int n) {
+        int i = 0;
+#if defined(__AVX512F__)
+        for (; i < n; i += 8) {
+            _mm512_store_si512(out + i, transpose_vec(_mm512_load_si512(in + i)));
+        }
+#elif defined(__AVX2__)
+        for (; i < n; i += 4) {
+            const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(out + i), transpose_vec(b));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = transpose(in[i]);
+        }
+    }
+
+    // replaces every row of the first n boards with its entry in the row table
+    static void shift_rows(const std::array<row_t, ROWS + 2>& shift, board_t* boards, const int n) {
+        int i = 0;
+#if defined(__AVX512F__)
+        // 16 rows (4 boards) per gather
+        for (; i < n; i += 4) {
+            const __m512i idx = _mm512_cvtepu16_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(boards + i)));
+            const __m512i rows = _mm512_i32gather_epi32(idx, shift.data(), 2);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(boards + i), _mm512_cvtepi32_epi16(rows));
+        }
+#elif defined(__AVX2__)
+        // 8 rows (2 boards) per gather
+        const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+        for (; i < n; i += 2) {
+            const __m256i idx = _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(boards + i)));
+            const __m256i rows = _mm256_and_si256(
+                    _mm256_i32gather_epi32(reinterpret_cast<const int*>(shift.data()), idx, 2), low_mask);
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rows, rows), 0b1000);
+            _mm_store_si128(reinterpret_cast<__m128i*>(boards + i), _mm256_castsi256_si128(packed));
+        }
+#endif
+        for (; i < n; ++i) {
+            const board_t b = boards[i];
+            boards[i] = (static_cast<board_t>(shift[(b >> 48) & 0xFFFF]) << 48) |
+                        (static_cast<board_t>(shift[(b >> 32) & 0xFFFF]) << 32) |
+                        (static_cast<board_t>(shift[(b >> 16) & 0xFFFF]) << 16) |
+                        (static_cast<board_t>(shift[ b        & 0xFFFF]));
+        }
+    }
+
+    // bitmask of the lanes where the board was changed by the move
+    static uint64_t changed_lanes(const board_t* before, const board_t* after, const int n) {
+        uint64_t lanes = 0;
+        int i = 0;
+#if defined(__AVX512F__)
+        for (; i < n; i += 8) {
+            lanes |= static_cast<uint64_t>(_mm512_cmpneq_epu64_mask(_mm512_load_si512(before + i),
+                                                                     _mm512_load_si512(after + i))) << i;
+        }
+#elif defined(__AVX2__)
+        for (; i < n; i += 4) {
+            const __m256i same = _mm256_cmpeq_epi64(_mm256_load_si256(reinterpret_cast<const __m256i*>(before + i)),
+                                                    _mm256_load_si256(reinterpret_cast<const __m256i*>(after + i)));
+            lanes |= static_cast<uint64_t>(~_mm256_movemask_pd(_mm256_castsi256_pd(same)) & 0xF) << i;
+        }
+#endif
+        for (; i < n; ++i) {
+            lanes |= static_cast<uint64_t>(before[i] != after[i]) << i;
+        }
+        return lanes;
+    }
+
+    int padded_active() const {
+        return (active + VECTOR_WIDTH - 1) & ~(VECTOR_WIDTH - 1);
+    }
+
+    // the game's stream only depends on the run seed and its index in the whole run, the same as in the tester's play_game,
+    // so results don't change with the number of threads or lanes, and game i here is game i with GameSimulator
+    uint64_t game_seed(const int idx) const {
+        return derive_seed(run_seed, first_game + idx);
+    }
+
+    void start_game(const int lane, const int idx) {
+        game_idx[lane] = idx;
+        spawn_rng[lane].seed(game_seed(idx));  // same as GameSimulator::seed
+        fours[lane] = 0;
+        boards[lane] = 0;
+        boards[lane] = add_tile(lane, boards[lane]);
+        boards[lane] = add_tile(lane, boards[lane]);
+    }
+
+    // moves the last active lane into this lane; the lane at the end is cleared so it stays a harmless full-stop board
+    void drop_lane(const int lane) {
+        --active;
+        boards[lane] = boards[active];
+        spawn_rng[lane] = spawn_rng[active];
+        game_idx[lane] = game_idx[active];
+        fours[lane] = fours[active];
+        boards[active] = 0;
+    }
+
+public:
+    BatchGameSimulator(const uint64_t _run_seed = get_current_time_ms(), const int _first_game = 0) :
+            run_seed(_run_seed), first_game(_first_game) {
+        std::fill(boards, boards + LANES, 0);
+    }
+
+    // computes next[dir][i] = make_move(boards[i], dir) for every active lane
+    // same as GameSimulator::make_move: left and right use their own row tables, and up and down shift the rows of the transposed boards
+    void make_moves(const int dir) {
+        const int n = padded_active();
+        if (dir & 1) {
+            transpose_boards(next[dir], boards, n);
+        } else {
+            std::copy(boards, boards + n, next[dir]);
+        }
+        shift_rows(dir >= 2 ? row_right : row_left, next[dir], n);
+        if (dir & 1) {
+            transpose_boards(next[dir], next[dir], n);
+        }
+        legal[dir] = changed_lanes(boards, next[dir], n);
+    }
+
+    void make_moves() {
+        for (int dir = 0; dir < 4; ++dir) make_moves(dir);
+    }
+
+    // bitmask of the lanes that can make a move in this direction, relies on make_moves having been called
+    uint64_t legal_lanes(const int dir) const {
+        return legal[dir];
+    }
+
+    // 4-bit mask of which moves are legal for a lane, relies on make_moves having been called
+    int legal_moves(const int lane) const {
+        return ((legal[0] >> lane) & 1) | (((legal[1] >> lane) & 1) << 1) |
+               (((legal[2] >> lane) & 1) << 2) | (((legal[3] >> lane) & 1) << 3);
+    }
+
+    // bitmask of the active lanes whose game is over, relies on make_moves having been called
+    uint64_t game_over_lanes() const {
+        const uint64_t active_lanes = active == 64 ? ~0ULL : (1ULL << active) - 1;
+        return active_lanes & ~(legal[0] | legal[1] | legal[2] | legal[3]);
+    }
+
+    // same draw as GameSimulator::draw_game_spawn: 90% for a 2, 10% for a 4, on a uniformly random empty tile
+    board_t add_tile(const int lane, const board_t board) {
+        const uint64_t r = spawn_rng[lane]();
+        const board_t tile_val = GameSimulator::tile_val_from_bits(r >> 32);
+
+        fours[lane] += tile_val == 2;
+        return board | (tile_val << GameSimulator::empty_position_from_bits(board, r));
+    }
+
+    void add_tiles() {
+        for (int i = 0; i < active; ++i) boards[i] = add_tile(i, boards[i]);
+    }
+
+    // plays the given number of games; policy.pick_move(lane, board, legal_moves) must return a legal move,
+    // and on_game_over(game_index, board, fours) is called once for each game as soon as it ends
+    // policy.new_game(lane, seed) gets derive_seed(game_seed, 1), which is what RandomPlayer and SpamCornerPlayer seed their moves with
+    template<class Policy, class Callback>
+    void play(Policy& policy, const int games, Callback on_game_over) {
+        int started = 0;
+        active = 0;
+        while (active < LANES && started < games) {
+            policy.new_game(active, derive_seed(game_seed(started), 1));
+            start_game(active++, started++);
+        }
+
+        while (active > 0) {
+            make_moves();
+
+            uint64_t over = game_over_lanes();
+            // go from the highest lane down so that compacting never moves a finished lane into an unchecked slot
+            // this counts down instead of using 63 - countl_zero(over), which g++ 12 at -O3 can turn into an address past the end
+            // of a local policy; its alias analysis then moves the read of a new game's first mt19937_64 word above the seeding
+            for (int lane = active - 1; over != 0; --lane) {
+                if (((over >> lane) & 1) == 0) continue;
+                over ^= 1ULL << lane;
+
+                on_game_over(game_idx[lane], boards[lane], fours[lane]);
+                if (started < games) {
+                    policy.new_game(lane, derive_seed(game_seed(started), 1));
+                    start_game(lane, started++);
+                    // the replacement game needs its moves recalculated, so it just sits out this step
+                    for (int dir = 0; dir < 4; ++dir) legal[dir] &= ~(1ULL << lane);
+                } else {
+                    policy.move_lane(lane, active - 1);
+                    drop_lane(lane);
+                    for (int dir = 0; dir < 4; ++dir) {
+                        next[dir][lane] = next[dir][active];
+                        legal[dir] = (legal[dir] & ~(1ULL << lane)) | (((legal[dir] >> active) & 1) << lane);
+                        legal[dir] &= ~(1ULL << active);
+                    }
+                }
+            }
+
+            for (int i = 0; i < active; ++i) {
+                const int legal = legal_moves(i);
+                if (legal == 0) continue;  // a freshly started game that's sitting out this step
+
+                const int dir = policy.pick_move(i, boards[i], legal);
+                assert((legal >> dir) & 1);
+                // a board can't be full right after a legal move, so there's always space for the new tile
+                boards[i] = add_tile(i, next[dir][i]);
+            }
+        }
+    }
+};
+
+// batched counterparts of the blind players, which only need to know which moves are legal
+// each policy keeps separate state for every lane so that lanes don't interfere with each other,
+// and the random ones draw their moves the same way as their players, so both play the same games for the same seeds
+
+// picks a uniformly random legal move, like RandomPlayer
+template<int LANES = 32>
+class BatchRandomPolicy {
+    rng_t move_gen[LANES];
+
+public:
+    void new_game(const int lane, const uint64_t seed) {
+        move_gen[lane].seed(seed);
+    }
+
+    void move_lane(const int to, const int from) {
+        move_gen[to] = move_gen[from];
+    }
+
+    int pick_move(const int lane, const board_t, const int legal) {
+        int move;
+        do {
+            move = move_gen[lane]() >> 62;
+        } while (((legal >> move) & 1) == 0);
+        return move;
+    }
+};
+
+// randomly picks left or up, falling back to the other moves, like SpamCornerPlayer
+template<int LANES = 32>
+class BatchSpamCornerPolicy {
+    rng_t move_gen[LANES];
+
+public:
+    void new_game(const int lane, const uint64_t seed) {
+        move_gen[lane].seed(seed);
+    }
+
+    void move_lane(const int to, const int from) {
+        move_gen[to] = move_gen[from];
+    }
+
+    int pick_move(const int lane, const board_t, const int legal) {
+        const int move = move_gen[lane]() >> 63;
+        if ((legal >> move) & 1) return move;
+        if ((legal >> (move ^ 1)) & 1) return move ^ 1;
+        if ((legal >> (move ^ 2)) & 1) return move ^ 2;
+        return move ^ 3;
+    }
+};
+
+// picks the first legal move out of left, up, right, down, like OrderedPlayer
+template<int LANES = 32>
+class BatchOrderedPolicy {
+public:
+    void new_game(const int, const uint64_t) {}
+
+    void move_lane(const int, const int) {}
+
+    int pick_move(const int, const board_t, const int legal) {
+        return std::countr_zero(static_cast<unsigned>(legal));
+    }
+};
+
+// cycles through the moves in order, skipping illegal ones, like RotatingPlayer
+template<int LANES = 32>
+class BatchRotatingPolicy {
+    int current_move[LANES];
+
+public:
+    void new_game(const int lane, const uint64_t) {
+        current_move[lane] = 0;
+    }
+
+    void move_lane(const int to, const int from) {
+        current_move[to] = current_move[from];
+    }
+
+    int pick_move(const int lane, const board_t, const int legal) {
+        do {
+            current_move[lane] = (current_move[lane] + 1) & 3;
+        } while (((legal >> current_move[lane]) & 1) == 0);
+        return current_move[lane];
+    }
+};
+
+#endif
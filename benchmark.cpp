@@ -1,9 +1,17 @@
+// uncomment to print search statistics after test_player (which slows down the searches a bit); see search_stats.hpp
+// benchmark_canonical_cache also needs this for the cache hit rates
+//#define SEARCH_STATS
+
+#include <algorithm>
 #include <iostream>
 
+#include "batch_game.hpp"
 #include "game.hpp"
 #include "heuristics.hpp"
+#include "record.hpp"
 #include "strategies/ExpectimaxDepthStrategy.hpp"
 #include "strategies/ExpectimaxProbabilityStrategy.hpp"
+#include "strategies/ExpectimaxTimeStrategy.hpp"
 #include "strategies/MinimaxStrategy.hpp"
 #include "strategies/MonteCarloPlayer.hpp"
 #include "strategies/OrderedPlayer.hpp"
@@ -22,18 +30,17 @@ long long score_total = 0;
 int move_total = 0;
 
 const int play_game(Strategy& player, const bool print_results) {
-    std::string record = "";
+    TextRecord record;
     const board_t board = player.simulator.play(player, record);
 
-    const int fours = count_fours(record);
-    move_total += count_moves_made(board, fours);
+    move_total += record.moves;
 
-    const int score = actual_score(board, fours);
+    const int score = record.score(board);
     score_total += score;
     if (print_results) {
-        std::cout << "Fours: " << fours << std::endl;
+        std::cout << "Fours: " << record.fours << std::endl;
         std::cout << "Score: " << score << std::endl;
-        std::cout << "Record: " << record << std::endl;
+        std::cout << "Record: " << record.text << std::endl;
     }
     return get_max_tile(board);
 }
@@ -41,6 +48,7 @@ const int play_game(Strategy& player, const bool print_results) {
 void test_player(Strategy& player, const int games) {
     std::fill(results, results + MAX_TILE + 1, 0);
     score_total = move_total = 0;
+    player.stats = SearchStats();
 
     const long long start_time = get_current_time_ms();
     for (int i = 1; i <= games; ++i) {
@@ -58,6 +66,402 @@ void test_player(Strategy& player, const int games) {
     }
     std::cout << "Average score: " << score_total * 1.0 / games << std::endl;
     std::cout << "Total moves: " << move_total << std::endl;
+    player.stats.print(std::cout);
+}
+
+// the old make_move, which transposes and flips the board around a single left-shift table
+board_t make_move_transposed(const GameSimulator& simulator, board_t board, const int dir) {
+    if (dir & 1) board = transpose(board);
+    if (dir >= 2) board = flip_h(board);
+    board = simulator.make_move<0>(board);
+    if (dir >= 2) board = flip_h(board);
+    return (dir & 1) ? transpose(board) : board;
+}
+
+// compares the direction-specific move tables against the transpose-and-flip path on the same random boards
+void benchmark_make_move(const int iterations) {
+    GameSimulator simulator;
+    std::mt19937_64 gen(8);
+    std::vector<board_t> boards(1 << 12);
+    for (board_t& board: boards) board = gen() & gen();  // leave some empty tiles so that moves can slide
+
+    for (const board_t board: boards) {
+        for (int dir = 0; dir < 4; ++dir) assert(simulator.make_move(board, dir) == make_move_transposed(simulator, board, dir));
+    }
+
+    board_t checksum = 0;
+    long long start_time = get_current_time_ms();
+    for (int i = 0; i < iterations; ++i) {
+        for (const board_t board: boards) {
+            checksum += make_move_transposed(simulator, board, 0) ^ make_move_transposed(simulator, board, 1) ^
+                        make_move_transposed(simulator, board, 2) ^ make_move_transposed(simulator, board, 3);
+        }
+    }
+    const long long transposed_time = get_current_time_ms() - start_time;
+
+    start_time = get_current_time_ms();
+    for (int i = 0; i < iterations; ++i) {
+        for (const board_t board: boards) {
+            checksum -= simulator.make_move<0>(board) ^ simulator.make_move<1>(board) ^
+                        simulator.make_move<2>(board) ^ simulator.make_move<3>(board);
+        }
+    }
+    const long long table_time = get_current_time_ms() - start_time;
+
+    const long long moves = 4LL * iterations * boards.size();
+    std::cout << "Transposed moves: " << transposed_time << "ms (" << transposed_time * 1e6 / moves << "ns per move)" << std::endl;
+    std::cout << "Direction tables: " << table_time << "ms (" << table_time * 1e6 / moves << "ns per move)" << std::endl;
+    std::cout << "Checksum: " << checksum << std::endl;  // should be 0, and keeps the loops from being optimized out
+}
+
+// the corner and wall heuristics from before they were turned into row tables, which look up every tile separately
+namespace tile_heuristics {
+    using heuristics::tile_val, heuristics::tile_exp, heuristics::score_heuristic;
+
+    eval_t corner_heuristic(const board_t board) {
+        const eval_t lower_left =  10 * tile_val(board, 0, 3) + 5 * tile_val(board, 0, 2) + 2 * tile_val(board, 0, 1) + 1 * tile_val(board, 0, 0) +
+                                   5  * tile_val(board, 1, 3) + 3 * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 1) +
+                                   2  * tile_val(board, 2, 3) + 1 * tile_val(board, 2, 2) +
+                                   1  * tile_val(board, 3, 3);
+
+        const eval_t upper_left =  10 * tile_val(board, 3, 3) + 5 * tile_val(board, 3, 2) + 2 * tile_val(board, 3, 1) + 1 * tile_val(board, 3, 0) +
+                                   5  * tile_val(board, 2, 3) + 3 * tile_val(board, 2, 2) + 1 * tile_val(board, 2, 1) +
+                                   2  * tile_val(board, 1, 3) + 1 * tile_val(board, 1, 2) +
+                                   1  * tile_val(board, 0, 3);
+
+        const eval_t lower_right = 10 * tile_val(board, 0, 0) + 5 * tile_val(board, 0, 1) + 2 * tile_val(board, 0, 2) + 1 * tile_val(board, 0, 3) +
+                                   5  * tile_val(board, 1, 0) + 3 * tile_val(board, 1, 1) + 1 * tile_val(board, 1, 2) +
+                                   2  * tile_val(board, 2, 0) + 1 * tile_val(board, 2, 1) +
+                                   1  * tile_val(board, 3, 0);
+
+        const eval_t upper_right = 10 * tile_val(board, 3, 0) + 5 * tile_val(board, 3, 1) + 2 * tile_val(board, 3, 2) + 1 * tile_val(board, 3, 3) +
+                                   5  * tile_val(board, 2, 0) + 3 * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 2) +
+                                   2  * tile_val(board, 1, 0) + 1 * tile_val(board, 1, 1) +
+                                   1  * tile_val(board, 0, 0);
+
+        return std::max({lower_left, upper_left, lower_right, upper_right});
+    }
+
+    eval_t _wall_gap_heuristic(const board_t board) {
+        const eval_t top =
+                (tile_exp(board, 3, 3) << 40) | (tile_exp(board, 3, 2) << 36) | (tile_exp(board, 3, 1) << 32) |
+                (tile_exp(board, 2, 3) << 20) | (tile_exp(board, 2, 2) << 24) | (tile_exp(board, 2, 1) << 28) |
+                (tile_exp(board, 1, 3) << 16) | (tile_exp(board, 1, 2) << 12) | (tile_exp(board, 1, 1) << 8);
+
+        const eval_t bottom =
+                (tile_exp(board, 0, 0) << 40) | (tile_exp(board, 0, 1) << 36) | (tile_exp(board, 0, 2) << 32) |
+                (tile_exp(board, 1, 0) << 20) | (tile_exp(board, 1, 1) << 24) | (tile_exp(board, 1, 2) << 28) |
+                (tile_exp(board, 2, 0) << 16) | (tile_exp(board, 2, 1) << 12) | (tile_exp(board, 2, 2) << 8);
+
+        const eval_t left =
+                (tile_exp(board, 0, 3) << 40) | (tile_exp(board, 1, 3) << 36) | (tile_exp(board, 2, 3) << 32) |
+                (tile_exp(board, 0, 2) << 20) | (tile_exp(board, 1, 2) << 24) | (tile_exp(board, 2, 2) << 28) |
+                (tile_exp(board, 0, 1) << 16) | (tile_exp(board, 1, 1) << 12) | (tile_exp(board, 2, 1) << 8);
+
+        const eval_t right =
+                (tile_exp(board, 3, 0) << 40) | (tile_exp(board, 2, 0) << 36) | (tile_exp(board, 1, 0) << 32) |
+                (tile_exp(board, 3, 1) << 20) | (tile_exp(board, 2, 1) << 24) | (tile_exp(board, 1, 1) << 28) |
+                (tile_exp(board, 3, 2) << 16) | (tile_exp(board, 2, 2) << 12) | (tile_exp(board, 1, 2) << 8);
+
+        return std::max({top, bottom, left, right});
+    }
+
+    eval_t wall_gap_heuristic(const board_t board) {
+        return std::max(_wall_gap_heuristic(board), _wall_gap_heuristic(transpose(board))) + score_heuristic(board);
+        // tiebreak by score
+    }
+
+    eval_t _full_wall_heuristic(const board_t board) {
+        const eval_t top =
+                (tile_exp(board, 3, 3) << 40) | (tile_exp(board, 3, 2) << 36) | (tile_exp(board, 3, 1) << 32) | (tile_exp(board, 3, 0) << 28) |
+                (tile_exp(board, 2, 3) << 12) | (tile_exp(board, 2, 2) << 16) | (tile_exp(board, 2, 1) << 20) | (tile_exp(board, 2, 0) << 24) |
+                (tile_exp(board, 1, 3) << 8);
+
+        const eval_t bottom =
+                (tile_exp(board, 0, 0) << 40) | (tile_exp(board, 0, 1) << 36) | (tile_exp(board, 0, 2) << 32) | (tile_exp(board, 0, 3) << 28) |
+                (tile_exp(board, 1, 0) << 12) | (tile_exp(board, 1, 1) << 16) | (tile_exp(board, 1, 2) << 20) | (tile_exp(board, 0, 3) << 24) |
+                (tile_exp(board, 2, 0) << 8);
+
+        const eval_t left =
+                (tile_exp(board, 0, 3) << 40) | (tile_exp(board, 1, 3) << 36) | (tile_exp(board, 2, 3) << 32) | (tile_exp(board, 3, 3) << 28) |
+                (tile_exp(board, 0, 2) << 12) | (tile_exp(board, 1, 2) << 16) | (tile_exp(board, 2, 2) << 20) | (tile_exp(board, 3, 2) << 24) |
+                (tile_exp(board, 0, 1) << 8);
+
+        const eval_t right =
+                (tile_exp(board, 3, 0) << 40) | (tile_exp(board, 2, 0) << 36) | (tile_exp(board, 1, 0) << 32) | (tile_exp(board, 0, 0) << 28) |
+                (tile_exp(board, 3, 1) << 12) | (tile_exp(board, 2, 1) << 16) | (tile_exp(board, 1, 1) << 20) | (tile_exp(board, 0, 1) << 24) |
+                (tile_exp(board, 3, 2) << 8);
+
+        return std::max({top, bottom, left, right});
+    }
+
+    eval_t full_wall_heuristic(const board_t board) {
+        return std::max(_full_wall_heuristic(board), _full_wall_heuristic(transpose(board))) + score_heuristic(board);
+        // tiebreak by score
+    }
+
+    eval_t _skewed_corner_heuristic(const board_t board) {
+        const eval_t top =
+                16 * tile_val(board, 3, 3) + 10 * tile_val(board, 3, 2) + 6 * tile_val(board, 3, 1) + 3 * tile_val(board, 3, 0) +
+                10 * tile_val(board, 2, 3) + 6  * tile_val(board, 2, 2) + 3 * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 0) +
+                4  * tile_val(board, 1, 3) + 3  * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 1) +
+                1  * tile_val(board, 0, 3) + 1  * tile_val(board, 0, 2);
+
+        const eval_t bottom =
+                16 * tile_val(board, 0, 0) + 10 * tile_val(board, 0, 1) + 6 * tile_val(board, 0, 2) + 3 * tile_val(board, 0, 3) +
+                10 * tile_val(board, 1, 0) + 6  * tile_val(board, 1, 1) + 3 * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 3) +
+                4  * tile_val(board, 2, 0) + 3  * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 2) +
+                1  * tile_val(board, 3, 0) + 1  * tile_val(board, 3, 1);
+
+        const eval_t left =
+                16 * tile_val(board, 0, 3) + 10 * tile_val(board, 1, 3) + 6 * tile_val(board, 2, 3) + 3 * tile_val(board, 3, 3) +
+                10 * tile_val(board, 0, 2) + 6  * tile_val(board, 1, 2) + 3 * tile_val(board, 2, 2) + 1 * tile_val(board, 3, 2) +
+                4  * tile_val(board, 0, 1) + 3  * tile_val(board, 1, 1) + 1 * tile_val(board, 2, 1) +
+                1  * tile_val(board, 0, 0) + 1  * tile_val(board, 1, 0);
+
+        const eval_t right =
+                16 * tile_val(board, 3, 0) + 10 * tile_val(board, 2, 0) + 6 * tile_val(board, 1, 0) + 3 * tile_val(board, 0, 0) +
+                10 * tile_val(board, 3, 1) + 6  * tile_val(board, 2, 1) + 3 * tile_val(board, 1, 1) + 1 * tile_val(board, 0, 1) +
+                4  * tile_val(board, 3, 2) + 3  * tile_val(board, 2, 2) + 1 * tile_val(board, 1, 2) +
+                1  * tile_val(board, 3, 3) + 1  * tile_val(board, 2, 3);
+
+        return std::max({top, bottom, left, right});
+    }
+
+    eval_t skewed_corner_heuristic(const board_t board) {
+        return std::max(_skewed_corner_heuristic(board), _skewed_corner_heuristic(transpose(board)));
+    }
+}
+
+// checks the row table heuristics against the tile-by-tile versions on the same random boards, and times both
+// also checks that a custom heuristic made from the skewed corner weights is as fast as the built-in one
+void benchmark_heuristics(const int iterations) {
+    const heuristic_t custom_skewed_corner = heuristics::make_weight_heuristic(0, {{
+        {0, 0, 1, 1},
+        {0, 1, 3, 4},
+        {1, 3, 6, 10},
+        {3, 6, 10, 16},
+    }}, false, true);
+
+    const heuristic_t table_versions[5] = {heuristics::corner_heuristic, heuristics::wall_gap_heuristic, heuristics::full_wall_heuristic,
+                                           heuristics::skewed_corner_heuristic, custom_skewed_corner};
+    const heuristic_t tile_versions[5] = {tile_heuristics::corner_heuristic, tile_heuristics::wall_gap_heuristic, tile_heuristics::full_wall_heuristic,
+                                          tile_heuristics::skewed_corner_heuristic, tile_heuristics::skewed_corner_heuristic};
+    const std::string names[5] = {"corner", "wall_gap", "full_wall", "skewed_corner", "custom skewed_corner"};
+
+    // random boards use every row about equally, so they're the worst case for the tables, since most lookups miss the cache
+    // boards from games have far fewer distinct rows, which is what the searches actually see
+    std::mt19937_64 gen(8);
+    std::vector<board_t> random_boards(1 << 12);
+    for (board_t& board: random_boards) board = gen() & gen();
+
+    std::vector<board_t> game_boards;
+    ExpectimaxDepthStrategy player(1, heuristics::corner_heuristic);
+    for (int i = 0; game_boards.size() < random_boards.size(); ++i) {
+        player.seed(derive_seed(run_seed, i));
+        board_t board = player.simulator.add_random_tile(player.simulator.add_random_tile(0));
+        while (!player.simulator.game_over(board) && game_boards.size() < random_boards.size()) {
+            board = player.simulator.add_random_tile(player.simulator.make_move(board, player.pick_move(board)));
+            game_boards.push_back(board);
+        }
+    }
+
+    for (int h = 0; h < 10; ++h) {
+        const std::vector<board_t>& boards = h < 5 ? random_boards : game_boards;
+        if (h == 0) std::cout << "Random boards:" << std::endl;
+        if (h == 5) std::cout << "Boards from games:" << std::endl;
+        for (const board_t board: boards) assert(table_versions[h % 5](board) == tile_versions[h % 5](board));
+
+        eval_t checksum = 0;
+        long long start_time = get_current_time_ms();
+        for (int i = 0; i < iterations; ++i) {
+            for (const board_t board: boards) checksum += tile_versions[h % 5](board);
+        }
+        const long long tile_time = get_current_time_ms() - start_time;
+
+        start_time = get_current_time_ms();
+        for (int i = 0; i < iterations; ++i) {
+            for (const board_t board: boards) checksum -= table_versions[h % 5](board);
+        }
+        const long long table_time = get_current_time_ms() - start_time;
+
+        const long long evaluations = 1LL * iterations * boards.size();
+        std::cout << names[h % 5] << ": " << tile_time * 1e6 / evaluations << "ns per evaluation by tile, "
+                  << table_time * 1e6 / evaluations << "ns with row tables (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+// plays the same games with and without symmetry-canonical cache keys, and compares how often the cache hits
+void benchmark_canonical_cache(const int depth, const int games) {
+    for (const bool canonical: {false, true}) {
+        ExpectimaxDepthStrategy player(depth, heuristics::corner_heuristic, canonical);
+        long long score = 0;
+        int moves = 0;
+
+        const long long start_time = get_current_time_ms();
+        for (int i = 0; i < games; ++i) {
+            player.seed(derive_seed(run_seed, i));
+            GameCounter counter;
+            score += counter.score(player.simulator.play(player, counter));
+            moves += counter.moves;
+            player.reset();
+        }
+        const long long time_taken = get_current_time_ms() - start_time;
+
+        std::cout << (canonical ? "Canonical keys: " : "Plain keys: ") << time_taken << "ms (" << time_taken * 1e3 / moves
+                  << "us per move), average score " << score * 1.0 / games << std::endl;
+        player.stats.print(std::cout);
+    }
+}
+
+// plays the same games with different cache sizes, to see how much memory the cache actually needs
+void benchmark_cache_size(const int depth, const int games) {
+    for (const size_t cache_bytes: {1 << 20, 4 << 20, 16 << 20, 64 << 20}) {
+        ExpectimaxDepthStrategy player(depth, heuristics::corner_heuristic, false, 1, cache_bytes);
+        long long score = 0;
+        int moves = 0;
+
+        const long long start_time = get_current_time_ms();
+        for (int i = 0; i < games; ++i) {
+            player.seed(derive_seed(run_seed, i));
+            GameCounter counter;
+            score += counter.score(player.simulator.play(player, counter));
+            moves += counter.moves;
+            player.reset();
+        }
+        const long long time_taken = get_current_time_ms() - start_time;
+
+        std::cout << (cache_bytes >> 20) << "MB cache: " << time_taken << "ms (" << time_taken * 1e3 / moves
+                  << "us per move), average score " << score * 1.0 / games << std::endl;
+        player.stats.print(std::cout);
+    }
+}
+
+// plays some games and saves the cache, then plays different games with and without the saved cache loaded
+void benchmark_saved_cache(const int depth, const int games, const std::string& filename) {
+    const auto play_games = [depth, games](const int first_game, const std::string& load_file, const std::string& save_file) {
+        ExpectimaxDepthStrategy player(depth, heuristics::corner_heuristic);
+        if (!load_file.empty()) std::cout << (player.load_cache(load_file) ? "Loaded " : "Couldn't load ") << load_file << std::endl;
+        player.share_cache();  // keeps the results from every game, so that all of them get saved
+        long long score = 0;
+        int moves = 0;
+
+        const long long start_time = get_current_time_ms();
+        for (int i = first_game; i < first_game + games; ++i) {
+            player.seed(derive_seed(run_seed, i));
+            GameCounter counter;
+            score += counter.score(player.simulator.play(player, counter));
+            moves += counter.moves;
+            player.reset();
+        }
+        const long long time_taken = get_current_time_ms() - start_time;
+        std::cout << time_taken << "ms (" << time_taken * 1e3 / moves << "us per move), average score " << score * 1.0 / games << std::endl;
+        player.stats.print(std::cout);
+
+        if (!save_file.empty()) std::cout << (player.save_cache(save_file) ? "Saved " : "Couldn't save ") << save_file << std::endl;
+    };
+
+    play_games(0, filename, filename);  // adds to the file if it's already there
+    std::cout << "Without the saved cache: ";
+    play_games(games, "", "");
+    std::cout << "With the saved cache: ";
+    play_games(games, filename, "");
+}
+
+// plays games with a single-threaded search, and times the parallel search on the same boards
+// the moves should always match with REQUIRE_DETERMINISTIC
+void benchmark_parallel_search(const int depth, const int games, const int threads) {
+    ExpectimaxDepthStrategy serial(depth, heuristics::corner_heuristic);
+    ExpectimaxDepthStrategy parallel(depth, heuristics::corner_heuristic, false, threads);
+    long long serial_time = 0, parallel_time = 0;
+    int moves = 0, mismatches = 0;
+
+    for (int i = 0; i < games; ++i) {
+        board_t board = 0;
+        for (int j = 0; j < 2; ++j) board = serial.simulator.add_random_tile(board);
+        while (!serial.simulator.game_over(board)) {
+            long long start_time = get_current_time_ms();
+            const int move = serial.pick_move(board);
+            serial_time += get_current_time_ms() - start_time;
+
+            start_time = get_current_time_ms();
+            mismatches += move != parallel.pick_move(board);
+            parallel_time += get_current_time_ms() - start_time;
+
+            ++moves;
+            board = serial.simulator.add_random_tile(serial.simulator.make_move(board, move));
+        }
+        serial.reset();
+        parallel.reset();
+    }
+
+    std::cout << "Single thread: " << serial_time << "ms (" << serial_time * 1e3 / moves << "us per move)" << std::endl;
+    std::cout << threads << " threads: " << parallel_time << "ms (" << parallel_time * 1e3 / moves << "us per move)" << std::endl;
+    std::cout << "Mismatched moves: " << mismatches << '/' << moves << std::endl;
+}
+
+// checks how close the time-limited expectimax stays to its limit, since the slowest moves matter more than the average
+void benchmark_time_limit(const long long time_limit, const int games) {
+    ExpectimaxTimeStrategy player(time_limit, heuristics::corner_heuristic);
+    std::vector<long long> move_times;
+    long long depth_total = 0, score_total = 0;
+
+    for (int i = 0; i < games; ++i) {
+        GameCounter counter;
+        board_t board = 0;
+        for (int j = 0; j < 2; ++j) {
+            const GameSimulator::Spawn spawn = player.simulator.draw_spawn(board);
+            board |= spawn.tile_val << spawn.position;
+            counter.add_spawn(spawn.position, spawn.tile_val);
+        }
+        while (!player.simulator.game_over(board)) {
+            const auto start_time = std::chrono::steady_clock::now();
+            const int move = player.pick_move(board);
+            move_times.push_back((std::chrono::steady_clock::now() - start_time) / std::chrono::microseconds(1));
+            depth_total += player.completed_depth;
+
+            board = player.simulator.make_move(board, move);
+            const GameSimulator::Spawn spawn = player.simulator.draw_spawn(board);
+            board |= spawn.tile_val << spawn.position;
+            counter.add_turn(move, spawn.position, spawn.tile_val);
+        }
+        score_total += counter.score(board);
+        player.reset();
+    }
+
+    std::sort(move_times.begin(), move_times.end());
+    const int moves = move_times.size();
+    std::cout << "Time limit " << time_limit << "us over " << moves << " moves: median " << move_times[moves / 2]
+              << "us, p99 " << move_times[moves * 99 / 100] << "us, max " << move_times.back() << "us" << std::endl;
+    std::cout << "Average depth: " << depth_total * 1.0 / moves << ", average score: " << score_total * 1.0 / games << std::endl;
+}
+
+// plays the same games with a batch policy and with its player, which should end on exactly the same boards
+// the policy is a local variable on purpose, since that's what g++ 12 used to miscompile with USE_MT19937 (see BatchGameSimulator::play)
+template<template<int> class Policy, class Player, int LANES = 32>
+void benchmark_batch_games(const std::string& name, const int games, const int first_game = 0) {
+    std::vector<board_t> batch_boards(games);
+    BatchGameSimulator<LANES> batch_simulator(run_seed, first_game);
+    Policy<LANES> policy;
+
+    long long start_time = get_current_time_ms();
+    batch_simulator.play(policy, games, [&batch_boards](const int game, const board_t board, const int) {
+        batch_boards[game] = board;
+    });
+    const long long batch_time = get_current_time_ms() - start_time;
+
+    Player player;
+    int mismatches = 0;
+    start_time = get_current_time_ms();
+    for (int i = 0; i < games; ++i) {
+        player.seed(derive_seed(run_seed, first_game + i));
+        GameCounter counter;
+        mismatches += player.simulator.play(player, counter) != batch_boards[i];
+    }
+    const long long single_time = get_current_time_ms() - start_time;
+
+    std::cout << name << ": " << batch_time << "ms in batches of " << LANES << ", " << single_time << "ms one at a time, "
+              << mismatches << " of " << games << " games ended on different boards" << std::endl;
 }
 
 //SpamCornerPlayer spam_corner_player{};
@@ -66,12 +470,21 @@ void test_player(Strategy& player, const int games) {
 ExpectimaxProbabilityStrategy expectimax_probability_strategy(0.005, heuristics::monotonicity_heuristic);
 
 int main() {
+    //benchmark_make_move(10000); return 0;
+    //benchmark_heuristics(1000); return 0;
+    //benchmark_canonical_cache(4, 5); return 0;
+    //benchmark_cache_size(4, 5); return 0;
+    //benchmark_saved_cache(4, 5, "corner-expmx.ttc"); return 0;
+    //benchmark_parallel_search(5, 1, std::thread::hardware_concurrency()); return 0;
+    //benchmark_time_limit(10000, 5); return 0;
+    //benchmark_batch_games<BatchRandomPolicy, RandomPlayer>("Random", 20000); benchmark_batch_games<BatchSpamCornerPolicy, SpamCornerPlayer>("Spam corner", 20000); return 0;
+
     //const auto player = std::make_unique<RandomPlayer>();
     //test_player(*player, int(1e6));
 
     //test_player(spam_corner_player, int(1e5));  // spam_corner is the most efficient blind strategy
 
-    std::string record = "";
+    TextRecord record;
 
     //UserPlayer user_player{};
     //user_player.simulator.play(user_player, record);
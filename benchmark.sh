@@ -1,4 +1,4 @@
-clang++ -std=c++20 -O3 -Wall -pthread -funroll-loops -flto -mcpu=native -fconstexpr-steps=0x500000 benchmark.cpp -o benchmark.out \
+clang++ -std=c++20 -O3 -Wall -pthread -funroll-loops -flto -mcpu=native benchmark.cpp -o benchmark.out \
 -DREQUIRE_DETERMINISTIC -DTESTING
 
 echo "Compiled benchmark.cpp!"
@@ -1,4 +1,6 @@
+#include <pybind11/functional.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "../../game.hpp"
 #include "../../heuristics.hpp"
 #include "../../strategies/ExpectimaxDepthStrategy.hpp"
@@ -15,9 +17,28 @@
 using pybind11::class_;
 using pybind11::init;
 
+// both of these return the heuristic index to give to the strategies, or -1 if the slot doesn't exist or the heuristic
+// could go out of range
+int set_weight_heuristic(const int slot, const heuristics::WeightMatrix& weights, const bool use_exponent, const bool use_transpose) {
+    if (slot < 0 || slot >= heuristics::CUSTOM_SLOTS) return -1;
+    if (heuristics::make_weight_heuristic(slot, weights, use_exponent, use_transpose) == nullptr) return -1;
+    return heuristics::FIRST_CUSTOM_EXPORT + slot;
+}
+
+int set_row_heuristic(const int slot, const std::function<eval_t(int, int)>& rule, const bool use_transpose) {
+    if (slot < 0 || slot >= heuristics::CUSTOM_SLOTS) return -1;
+    if (heuristics::make_row_heuristic(slot, rule, use_transpose) == nullptr) return -1;
+    return heuristics::FIRST_CUSTOM_EXPORT + slot;
+}
+
 PYBIND11_MODULE(players, m) {
     m.doc() = "Solving strategies for 2048 written in C++ and exported to Python";
 
+    m.def("set_weight_heuristic", &set_weight_heuristic,
+          "Makes a heuristic from a 4x4 weight matrix, where weights[r][c] multiplies tile (r, c)");
+    m.def("set_row_heuristic", &set_row_heuristic,
+          "Makes a heuristic from rule(r, row), which scores a 16-bit row when it's in row r of the board");
+
     class_<ExpectimaxDepthStrategy>(m, "ExpectimaxDepthStrategy")
         .def(init<const int, const int>())
         .def("pick_move", &ExpectimaxDepthStrategy::pick_move);
@@ -4,7 +4,7 @@ from setuptools import setup
 ext = Pybind11Extension("players", ["export_players.cpp"])
 ext.cxx_std = 20
 # surely there must be a better way to do this?
-ext._add_cflags(["-funroll-loops", "-flto", "-mcpu=native", "-fconstexpr-steps=0x500000", "-I/usr/local/include"])
+ext._add_cflags(["-funroll-loops", "-flto", "-mcpu=native"])
 
 ext_modules = [
     ext
@@ -16,6 +16,16 @@
 using emscripten::class_;
 using emscripten::function;
 
+// weights has the 16 weights from tile (0, 0) to tile (3, 3), going across each row
+// returns the heuristic index to give to the strategies, or -1 if the slot doesn't exist or the weights are too large or negative
+int set_weight_heuristic(const int slot, const emscripten::val& weights, const bool use_exponent, const bool use_transpose) {
+    if (slot < 0 || slot >= heuristics::CUSTOM_SLOTS) return -1;
+    heuristics::WeightMatrix matrix;
+    for (int i = 0; i < 16; ++i) matrix[i >> 2][i & 3] = weights[i].as<double>();
+    if (heuristics::make_weight_heuristic(slot, matrix, use_exponent, use_transpose) == nullptr) return -1;
+    return heuristics::FIRST_CUSTOM_EXPORT + slot;
+}
+
 EMSCRIPTEN_BINDINGS(players) {
     class_<ExpectimaxDepthStrategy>("ExpectimaxDepthStrategy")
         .constructor<const int, const int>()
@@ -65,5 +75,6 @@ EMSCRIPTEN_BINDINGS(players) {
     function("strict_wall_heuristic", &heuristics::strict_wall_heuristic);
     function("skewed_corner_heuristic", &heuristics::skewed_corner_heuristic);
     function("monotonicity_heuristic", &heuristics::monotonicity_heuristic);
+    function("set_weight_heuristic", &set_weight_heuristic);
 }
 
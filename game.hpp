@@ -6,14 +6,16 @@
 #include <iostream>
 #include <random>
 
+#include "rng.hpp"
 #include "util.hpp"
 
 class Strategy;  // Strategy depends on GameSimulator and will be #include-ed at the bottom
+template<int LANES> class BatchGameSimulator;  // shares the empty tile tables
 
 //static constexpr row_t WINNING_ROW = 0xFFFF; // 2^16 - 1, represents [32768, 32768, 32768, 32768], which is very unlikely
 
 // generates the precomputed arrays to compute the results of making a move
-consteval std::array<row_t, ROWS> generate_shift() {
+TABLE_GENERATOR std::array<row_t, ROWS> generate_shift() {
     std::array<row_t, ROWS> shift;
     for (int row = 0; row < ROWS; ++row) {
         int r[4] = {(row >> 12) & 0xF, (row >> 8) & 0xF, (row >> 4) & 0xF, row & 0xF};
@@ -45,6 +47,38 @@ consteval std::array<row_t, ROWS> generate_shift() {
     return shift;
 }
 
+// moving a row right is the same as reversing it, moving it left, and reversing it back
+TABLE_GENERATOR std::array<row_t, ROWS> generate_shift_right(const std::array<row_t, ROWS>& shift_left) {
+    std::array<row_t, ROWS> shift_right;
+    for (int row = 0; row < ROWS; ++row) {
+        shift_right[row] = reversed[shift_left[reversed[row]]];
+    }
+    return shift_right;
+}
+
+// moving up or down shifts the columns, which are the rows of the transposed board
+// each entry stores the shifted row as the rightmost column of a board, so the result can be shifted straight into place
+TABLE_GENERATOR std::array<board_t, ROWS> generate_shift_column(const std::array<row_t, ROWS>& shift_row) {
+    std::array<board_t, ROWS> shift_column;
+    for (int row = 0; row < ROWS; ++row) {
+        shift_column[row] = transpose(shift_row[row]);
+    }
+    return shift_column;
+}
+
+// whether each row can be moved left or right, so that legal moves can be found without making them
+// bit 0 is set if the row can move left and bit 2 is set if it can move right, which lines up with the direction numbers
+// the same table works for columns of the transposed board after shifting it up by one bit (up is 1, down is 3)
+TABLE_GENERATOR std::array<uint8_t, ROWS> generate_row_moves(const std::array<row_t, ROWS>& shift_left,
+                                                       const std::array<row_t, ROWS>& shift_right) {
+    std::array<uint8_t, ROWS> row_moves;
+    for (int row = 0; row < ROWS; ++row) {
+        row_moves[row] = (shift_left[row] != row) | ((shift_right[row] != row) << 2);
+    }
+    return row_moves;
+}
+
+#ifndef __BMI2__
 // the game mechanics include adding an tile to an empty position
 // to speed up the process, we can precompute where the empty tiles are for each possible board
 // since we only care about whether tiles are open or full, we can store a "tile mask" of the board where each tile is a boolean value
@@ -52,7 +86,7 @@ consteval std::array<row_t, ROWS> generate_shift() {
 // all empty tiles are in a single array, and a second array stores pointers to which sections correspond to which tile masks
 static constexpr int EMPTY_TILE_POSITIONS = 524288;  // exactly 524288 different values across all tile_masks
 static constexpr int EMPTY_MASKS = 0x10000;  // number of tile_masks, where an tile_mask stores whether a tile is empty
-consteval std::array<uint8_t, EMPTY_TILE_POSITIONS> generate_empty_tiles() {
+TABLE_GENERATOR std::array<uint8_t, EMPTY_TILE_POSITIONS> generate_empty_tiles() {
     std::array<uint8_t, EMPTY_TILE_POSITIONS> empty_tiles;
     int idx = 0;
     for (int em = 0; em < EMPTY_MASKS; ++em) {
@@ -66,7 +100,7 @@ consteval std::array<uint8_t, EMPTY_TILE_POSITIONS> generate_empty_tiles() {
     return empty_tiles;
 }
 
-consteval std::array<int, EMPTY_MASKS> generate_empty_index() {
+TABLE_GENERATOR std::array<int, EMPTY_MASKS> generate_empty_index() {
     std::array<int, EMPTY_MASKS> empty_index;
     int idx = 0;
     for (int em = 0; em < EMPTY_MASKS; ++em) {
@@ -80,153 +114,240 @@ consteval std::array<int, EMPTY_MASKS> generate_empty_index() {
     assert(idx == EMPTY_TILE_POSITIONS);
     return empty_index;
 }
+#endif
 
 class GameSimulator {
 //    static constexpr board_t WINNING_BOARD  = 0xFFFFFFFFFFFFFFFFULL;  // 2^64 - 1, represents grid full of 32768 tiles (which is impossible)
 
     static constexpr uint16_t FULL_MASK = 0xFFFF;
 
-    static constexpr std::array<row_t, ROWS> shift = generate_shift();
+    // one table for each direction, so that no move has to transpose or flip the board before and after the lookup
+    static LOOKUP_TABLE std::array<row_t, ROWS> row_left = generate_shift();
+    static LOOKUP_TABLE std::array<row_t, ROWS> row_right = generate_shift_right(row_left);
+    static LOOKUP_TABLE std::array<board_t, ROWS> col_up = generate_shift_column(row_left);
+    static LOOKUP_TABLE std::array<board_t, ROWS> col_down = generate_shift_column(row_right);
+    static LOOKUP_TABLE std::array<uint8_t, ROWS> row_moves = generate_row_moves(row_left, row_right);
 
+#ifndef __BMI2__
     // this uses a fancy way of implementing adjacency lists in competitive programming
     // stores the empty tile positions for each tile_mask
-    static constexpr std::array<uint8_t, EMPTY_TILE_POSITIONS> empty_tiles = generate_empty_tiles();
-    static constexpr std::array<int, EMPTY_MASKS> empty_index = generate_empty_index();  // a pointer to where this tile_mask starts
-
-    static constexpr std::array<char, 4> MOVES = {'l', 'u', 'r', 'd'};  // use lowercase to make counting # of 4's placed easier
-
-    std::mt19937 empty_tile_gen;
-    std::uniform_int_distribution<> empty_tile_distrib{0, 720720 - 1};
-    // 720720 is lcm(1, 2, 3, ... , 15, 16), providing an even distribution
+    // with BMI2, pdep picks the empty tile directly, so these 768KB aren't needed (and don't crowd out the heuristic tables)
+    static LOOKUP_TABLE std::array<uint8_t, EMPTY_TILE_POSITIONS> empty_tiles = generate_empty_tiles();
+    static LOOKUP_TABLE std::array<int, EMPTY_MASKS> empty_index = generate_empty_index();  // a pointer to where this tile_mask starts
+#endif
 
-public:
-    GameSimulator(const long long rng_seed = get_current_time_ms()) {
-        empty_tile_gen.seed(rng_seed);
-    }
+    // the game's own tiles come from spawn_rng, which nothing else draws from, and everything else (like a strategy
+    // simulating tiles while it searches) uses rng, so that two strategies seeded the same get the same stream of tiles
+    // no matter how much randomness they use themselves; that's what makes paired comparisons between strategies work
+    rng_t spawn_rng;
+    rng_t rng;
 
-    board_t make_move(board_t board, const int dir) const {  // 0=left, 1=up, 2=right, 3=down
-        if (dir & 1) board = transpose(board);
-        if (dir >= 2) board = flip_h(board);
-        board = (static_cast<board_t>(shift[(board >> 48) & 0xFFFF]) << 48) |
-                (static_cast<board_t>(shift[(board >> 32) & 0xFFFF]) << 32) |
-                (static_cast<board_t>(shift[(board >> 16) & 0xFFFF]) << 16) |
-                (static_cast<board_t>(shift[ board        & 0xFFFF]));
+    template<int LANES> friend class BatchGameSimulator;
 
-        // checks if the 65536 tile is reached
-//        if (shift[dir >> 1][(board >> 48) & 0xFFFF] == WINNING_ROW ||
-//            shift[dir >> 1][(board >> 32) & 0xFFFF] == WINNING_ROW ||
-//            shift[dir >> 1][(board >> 16) & 0xFFFF] == WINNING_ROW ||
-//            shift[dir >> 1][ board        & 0xFFFF] == WINNING_ROW) return WINNING_BOARD;
-        if (dir >= 2) board = flip_h(board);
-        return (dir & 1) ? transpose(board) : board;
-    }
+    // the stream for rng, counting down from the top so that it doesn't clash with the streams that strategies use
+    static constexpr uint64_t SEARCH_STREAM = ~0ULL;
 
-    board_t generate_random_tile_val() {
-        return 1ULL + ((empty_tile_distrib(empty_tile_gen) % 10) == 0);
+    // 90% for 2^1 = 2, 10% for 2^2 = 4
+    static board_t tile_val_from_bits(const uint32_t bits) {
+        return 1ULL + (bounded(bits, 10) == 0);
     }
 
-    uint8_t pick_empty_position(const board_t board) {
+    static uint8_t empty_position_from_bits(const board_t board, const uint32_t bits) {
         const uint16_t tile_mask = to_tile_mask(board);
 
         // can't add a tile to a full board
         // also prevents any possible overflow on the next few lines
         assert(tile_mask != FULL_MASK);
 
+#ifdef __BMI2__
+        return nth_empty_position(board, bounded(bits, count_empty(tile_mask)));
+#else
         const int option_count = empty_index[tile_mask + 1] - empty_index[tile_mask];
-        return empty_tiles[empty_index[tile_mask] + (empty_tile_distrib(empty_tile_gen) % option_count)];
+        return empty_tiles[empty_index[tile_mask] + bounded(bits, option_count)];
+#endif
+    }
+
+    // row i of the transposed board is column i of the board, and each column comes back out already in place
+    template<int dir>
+    board_t make_column_move(const board_t transposed) const {
+        const std::array<board_t, ROWS>& col_table = dir == 1 ? col_up : col_down;
+        return (col_table[(transposed >> 48) & 0xFFFF] << 12) |
+               (col_table[(transposed >> 32) & 0xFFFF] <<  8) |
+               (col_table[(transposed >> 16) & 0xFFFF] <<  4) |
+               (col_table[ transposed        & 0xFFFF]);
+    }
+
+public:
+    GameSimulator(const uint64_t rng_seed = get_current_time_ms()) {
+        seed(rng_seed);
+    }
+
+    void seed(const uint64_t rng_seed) {
+        spawn_rng.seed(rng_seed);
+        rng.seed(derive_seed(rng_seed, SEARCH_STREAM));
+    }
+
+    template<int dir>
+    board_t make_move(const board_t board) const {  // 0=left, 1=up, 2=right, 3=down
+        static_assert(0 <= dir && dir < 4);
+        if constexpr ((dir & 1) == 0) {
+            const std::array<row_t, ROWS>& row_table = dir == 0 ? row_left : row_right;
+            return (static_cast<board_t>(row_table[(board >> 48) & 0xFFFF]) << 48) |
+                   (static_cast<board_t>(row_table[(board >> 32) & 0xFFFF]) << 32) |
+                   (static_cast<board_t>(row_table[(board >> 16) & 0xFFFF]) << 16) |
+                   (static_cast<board_t>(row_table[ board        & 0xFFFF]));
+        } else {
+            return make_column_move<dir>(transpose(board));
+        }
+    }
+
+    board_t make_move(const board_t board, const int dir) const {  // 0=left, 1=up, 2=right, 3=down
+        switch (dir) {
+            case 0: return make_move<0>(board);
+            case 1: return make_move<1>(board);
+            case 2: return make_move<2>(board);
+            default: return make_move<3>(board);
+        }
+    }
+
+    // makes all four moves in one pass, with up and down sharing a single transpose
+    // returns a bitmask of the legal moves, where bit i is set if moving in direction i changes the board
+    int make_moves(const board_t board, board_t (&next)[4]) const {
+        const board_t transposed = transpose(board);
+        next[0] = make_move<0>(board);
+        next[1] = make_column_move<1>(transposed);
+        next[2] = make_move<2>(board);
+        next[3] = make_column_move<3>(transposed);
+        return (next[0] != board) | ((next[1] != board) << 1) | ((next[2] != board) << 2) | ((next[3] != board) << 3);
+    }
+
+    // bitmask of the legal moves, found with the row_moves table instead of making any moves
+    int legal_moves(const board_t board) const {
+        const board_t transposed = transpose(board);
+        const int row_legal = row_moves[(board >> 48) & 0xFFFF] | row_moves[(board >> 32) & 0xFFFF] |
+                              row_moves[(board >> 16) & 0xFFFF] | row_moves[ board        & 0xFFFF];
+        const int col_legal = row_moves[(transposed >> 48) & 0xFFFF] | row_moves[(transposed >> 32) & 0xFFFF] |
+                              row_moves[(transposed >> 16) & 0xFFFF] | row_moves[ transposed        & 0xFFFF];
+        return row_legal | (col_legal << 1);
+    }
+
+    board_t generate_random_tile_val() {
+        return tile_val_from_bits(rng() >> 32);
+    }
+
+    uint8_t pick_empty_position(const board_t board) {
+        return empty_position_from_bits(board, rng() >> 32);
     }
 
     board_t add_tile(const board_t board, const board_t tile_val) {
         return board | (tile_val << pick_empty_position(board));
     }
 
-    board_t add_tile(const board_t board, const board_t tile_val, std::string& record) {
-        const uint8_t position = pick_empty_position(board);
-        const board_t new_board = board | (tile_val << position);
+    struct Spawn {
+        uint8_t position;
+        board_t tile_val;
+    };
 
-        record.push_back((position / 4) + (tile_val == 1 ? 'a' : 'A'));
+    // picks a new tile for the board, where both the value and the position come from a single draw
+    Spawn draw_spawn(const board_t board) {
+        const uint64_t r = rng();
+        return {empty_position_from_bits(board, r), tile_val_from_bits(r >> 32)};
+    }
 
-        return new_board;
+    // same as add_tile(board, generate_random_tile_val()), but only uses one draw
+    board_t add_random_tile(const board_t board) {
+        const Spawn spawn = draw_spawn(board);
+        return board | (spawn.tile_val << spawn.position);
     }
 
+private:
+    // same as draw_spawn, but for the game itself
+    Spawn draw_game_spawn(const board_t board) {
+        const uint64_t r = spawn_rng();
+        return {empty_position_from_bits(board, r), tile_val_from_bits(r >> 32)};
+    }
+
+public:
+
     bool game_over(const board_t board) const {
-        return (board == make_move(board, 0) && board == make_move(board, 1) && board == make_move(board, 2) &&
-                board == make_move(board, 3));// || board == WINNING_BOARD;
+        return legal_moves(board) == 0;// || board == WINNING_BOARD;
     }
 
-    board_t play(Strategy&, std::string&);
+    // Record can be anything with add_spawn and add_turn; see record.hpp
+    template<class Record>
+    board_t play(Strategy&, Record&);
 
-    board_t play_slow(Strategy&, std::string&, void (*)(const board_t));
+    template<class Record>
+    board_t play_slow(Strategy&, Record&, void (*)(const board_t));
 };
 
 #include "strategies/Strategy.hpp"
 
-board_t GameSimulator::play(Strategy& player, std::string& record) {
-    // reserve space for 6000 chars, enough for almost 3000 moves. should be enough for most games
-    record.reserve(6000);
-
-    const board_t tile_val0 = generate_random_tile_val();
-    const board_t tile_val1 = generate_random_tile_val();
-    board_t board = add_tile(0, tile_val0, record);
-    board = add_tile(board, tile_val1, record);
-
-    while (!game_over(board)) {
-        const board_t old_board = board;
+template<class Record>
+board_t GameSimulator::play(Strategy& player, Record& record) {
+    board_t board = 0;
+    for (int i = 0; i < 2; ++i) {
+        const Spawn spawn = draw_game_spawn(board);
+        board |= spawn.tile_val << spawn.position;
+        record.add_spawn(spawn.position, spawn.tile_val);
+    }
 
+    for (int legal = legal_moves(board); legal != 0; legal = legal_moves(board)) {
         int attempts = 0x10000;
         int dir;
-        while (old_board == board) {
+        do {
+            const auto start_time = player.stats.start_move();
             dir = player.pick_move(board);
+            player.stats.end_move(start_time);
             assert(0 <= dir && dir < 4);
-            board = make_move(board, dir);
 
             assert(--attempts > 0);  // abort the game if the strategy keeps picking an invalid move
-        }
-        record.push_back(MOVES[dir]);
+        } while (((legal >> dir) & 1) == 0);
+        board = make_move(board, dir);
 
-        if (game_over(board)) return board;
+        // a legal move always leaves an empty tile, and a board with an empty tile always has a legal move
+        // so the game can't be over until after the new tile is added
 
-        // 90% for 2^1 = 2, 10% for 2^2 = 4
-        const board_t new_tile_val = generate_random_tile_val();
-        board = add_tile(board, new_tile_val, record);
+        const Spawn spawn = draw_game_spawn(board);
+        board |= spawn.tile_val << spawn.position;
+        record.add_turn(dir, spawn.position, spawn.tile_val);
     }
 
     return board;
 }
 
 // similar to GameSimulator::play, but pauses the game for debugging purposes
-board_t GameSimulator::play_slow(Strategy& player, std::string& record, void (*callback)(const board_t)) {
-    const board_t tile_val0 = generate_random_tile_val();
-    const board_t tile_val1 = generate_random_tile_val();
-    board_t board = add_tile(0, tile_val0, record);
-    board = add_tile(board, tile_val1, record);
+template<class Record>
+board_t GameSimulator::play_slow(Strategy& player, Record& record, void (*callback)(const board_t)) {
+    board_t board = 0;
+    for (int i = 0; i < 2; ++i) {
+        const Spawn spawn = draw_game_spawn(board);
+        board |= spawn.tile_val << spawn.position;
+        record.add_spawn(spawn.position, spawn.tile_val);
+    }
 
     int moves = 0;
-    while (!game_over(board)) {
+    for (int legal = legal_moves(board); legal != 0; legal = legal_moves(board)) {
         if (moves-- == 0) {
             print_board(board);
             callback(board);
             std::cout << "Moves to jump? ";
             std::cin >> moves;
         }
-        const board_t old_board = board;
 
         int attempts = 0x10000;
         int dir;
-        while (old_board == board) {
+        do {
             dir = player.pick_move(board);
             assert(0 <= dir && dir < 4);
-            board = make_move(board, dir);
 
             assert(--attempts > 0);  // abort the game if the strategy keeps picking an invalid move
-        }
-        record.push_back(MOVES[dir]);
-
-        if (game_over(board)) return board;
+        } while (((legal >> dir) & 1) == 0);
+        board = make_move(board, dir);
 
-        // 90% for 2^1 = 2, 10% for 2^2 = 4
-        const board_t new_tile_val = generate_random_tile_val();
-        board = add_tile(board, new_tile_val, record);
+        const Spawn spawn = draw_game_spawn(board);
+        board |= spawn.tile_val << spawn.position;
+        record.add_turn(dir, spawn.position, spawn.tile_val);
     }
 
     return board;
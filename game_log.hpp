@@ -0,0 +1,156 @@
+#ifndef GAME_LOG_HPP
+#define GAME_LOG_HPP
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// append-only log of every game the tester plays, so that a run that gets interrupted can pick up where it left off,
+// and so that results/collate.py can rebuild the CSVs from the games themselves instead of from the totals
+// the file is a FileHeader, and then ConfigEntry and GameEntry structs in the order they were written, each starting with
+// its kind; a config comes before any of its games, and everything is little-endian, in the same layout as in memory
+// each entry is written with a single write and flushed right away, so a crash loses at most the entries being written,
+// and a half-written entry at the end of the file is cut off the next time the log is opened
+class GameLog {
+public:
+    enum Kind : uint32_t {
+        CONFIG = 1, GAME = 2
+    };
+
+    // a player, with the seed its games are derived from; the id is its index in the log
+    struct ConfigEntry {
+        uint32_t kind = CONFIG;
+        uint32_t config;
+        uint64_t seed;
+        uint32_t games;  // how many games the player was going to play when it started
+        uint32_t padding = 0;
+        char name[72];
+    };
+
+    struct GameEntry {
+        uint32_t kind = GAME;
+        uint32_t config;
+        uint64_t seed;  // the seed the game itself was played with
+        uint32_t game;  // index of the game, which is what the seed was derived from
+        uint32_t max_tile;
+        uint32_t score;
+        uint32_t moves;
+        int64_t time_ns;
+        int64_t nodes;  // positions searched, which are only counted with SEARCH_STATS
+    };
+
+private:
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t padding;
+    };
+
+    static constexpr char FILE_MAGIC[8] = "2048log";
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    static_assert(sizeof(ConfigEntry) == 96 && sizeof(GameEntry) == 48);
+
+    std::ofstream out;
+    std::mutex lock;
+    std::vector<ConfigEntry> configs;
+    std::unordered_map<uint64_t, GameEntry> logged_games;  // every game that was in the file when it was opened
+
+    static uint64_t game_key(const uint32_t config, const uint32_t game) {
+        return (static_cast<uint64_t>(config) << 32) | game;
+    }
+
+    // returns how much of the file holds complete entries
+    size_t load(const std::string& filename) {
+        std::ifstream fin(filename, std::ios::binary);
+        FileHeader header{};
+        if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header))) return 0;  // new file, or the header never got written
+        assert(std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 && header.version == FILE_VERSION);
+
+        size_t complete = sizeof(header);
+        uint32_t kind;
+        while (fin.read(reinterpret_cast<char*>(&kind), sizeof(kind))) {
+            fin.seekg(-static_cast<std::streamoff>(sizeof(kind)), std::ios::cur);
+            if (kind == CONFIG) {
+                ConfigEntry entry;
+                if (!fin.read(reinterpret_cast<char*>(&entry), sizeof(entry))) break;
+                entry.name[sizeof(entry.name) - 1] = '\0';
+                configs.push_back(entry);
+                complete += sizeof(entry);
+            } else if (kind == GAME) {
+                GameEntry entry;
+                if (!fin.read(reinterpret_cast<char*>(&entry), sizeof(entry))) break;
+                logged_games[game_key(entry.config, entry.game)] = entry;
+                complete += sizeof(entry);
+            } else {
+                break;  // garbage from a write that didn't finish
+            }
+        }
+        return complete;
+    }
+
+    void write(const void* entry, const size_t size) {
+        out.write(static_cast<const char*>(entry), size);
+        out.flush();
+    }
+
+public:
+    GameLog(const std::string& filename) {
+        const size_t complete = load(filename);
+        if (complete > 0) std::filesystem::resize_file(filename, complete);
+        out.open(filename, std::ios::binary | std::ios::app);
+        assert(out.is_open());  // might need to create the directory if this doesn't work
+        if (complete == 0) {
+            FileHeader header{};
+            std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+            header.version = FILE_VERSION;
+            write(&header, sizeof(header));
+        }
+    }
+
+    // returns the player's id, and replaces seed with the one it had if the player is already in the log,
+    // so that the games it hasn't played yet are the same ones it would've played without the interruption
+    uint32_t start_config(const std::string& name, const int games, uint64_t& seed) {
+        assert(name.size() < sizeof(ConfigEntry::name));
+        for (const ConfigEntry& config: configs) {
+            if (name == config.name) {
+                seed = config.seed;
+                return config.config;
+            }
+        }
+
+        ConfigEntry entry{};
+        entry.kind = CONFIG;
+        entry.config = configs.size();
+        entry.seed = seed;
+        entry.games = games;
+        std::strcpy(entry.name, name.c_str());
+        configs.push_back(entry);
+        std::lock_guard<std::mutex> guard(lock);
+        write(&entry, sizeof(entry));
+        return entry.config;
+    }
+
+    // the game's entry if it was already played before the log was opened, and nullptr otherwise
+    // the logged games never change once the log is opened, so this is safe to call from any thread
+    const GameEntry* find_game(const uint32_t config, const uint32_t game) const {
+        const auto it = logged_games.find(game_key(config, game));
+        return it == logged_games.end() ? nullptr : &it->second;
+    }
+
+    void add_game(const GameEntry& entry) {
+        std::lock_guard<std::mutex> guard(lock);
+        write(&entry, sizeof(entry));
+    }
+
+    void close() {
+        out.close();
+    }
+};
+
+#endif
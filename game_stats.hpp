@@ -0,0 +1,169 @@
+#ifndef GAME_STATS_HPP
+#define GAME_STATS_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// statistics over a stream of values (like every game's score) that take the same memory no matter how many values there are,
+// so that a run can play millions of games without keeping every result around and sorting them at the end
+// each thread can keep its own and they get merged afterwards, since += gives the same result as adding every value to one
+
+// histogram with buckets that grow with the value, so that every bucket is within 1/128 of the values in it
+// values below 256 get a bucket each, so quantiles of small values (like move counts in short games) are exact
+// this is the bucketing from HdrHistogram; unlike sampling sketches (KLL, t-digest), merging is just adding up counts,
+// so the quantiles don't depend on how the values were split up between threads
+class QuantileSketch {
+    static constexpr int SUB_BITS = 7;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;  // enough for every uint64_t
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t count = 0;
+
+    static int bucket_for(const uint64_t value) {
+        const int shift = std::max(0, static_cast<int>(std::bit_width(value)) - (SUB_BITS + 1));
+        return (shift << SUB_BITS) + static_cast<int>(value >> shift);
+    }
+
+    // middle of the bucket's range, which is the exact value for the buckets that only hold one value
+    static uint64_t bucket_value(const int bucket) {
+        if (bucket < 2 * SUB_BUCKETS) return bucket;
+        const int shift = (bucket >> SUB_BITS) - 1;
+        const uint64_t low = static_cast<uint64_t>((bucket & (SUB_BUCKETS - 1)) | SUB_BUCKETS) << shift;
+        return low + ((1ULL << shift) - 1) / 2;
+    }
+
+public:
+    void add(const uint64_t value) {
+        ++counts[bucket_for(value)];
+        ++count;
+    }
+
+    // the value with this many smaller values, counting from 0
+    uint64_t value_at_rank(const uint64_t rank) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > rank) return bucket_value(i);
+        }
+        return 0;  // there's nothing in the sketch
+    }
+
+    // nearest rank, so quantile(0.9) of 10 values is the largest one
+    uint64_t quantile(const double q) const {
+        if (count == 0) return 0;
+        return value_at_rank(std::min(count - 1, static_cast<uint64_t>(q * count)));
+    }
+
+    // mean of the two middle values if there's an even number of them
+    double median() const {
+        if (count == 0) return 0;
+        return (value_at_rank((count - 1) / 2) + value_at_rank(count / 2)) / 2.0;
+    }
+
+    QuantileSketch& operator+=(const QuantileSketch& other) {
+        for (int i = 0; i < BUCKETS; ++i) counts[i] += other.counts[i];
+        count += other.count;
+        return *this;
+    }
+};
+
+// exact count, total, mean, variance, min and max
+// the mean and variance use Welford's method, and merging uses Chan et al.'s parallel version of it,
+// since summing squares loses too much precision once there's millions of large scores
+class RunningStats {
+    uint64_t n = 0;
+    long long sum = 0;
+    double mean_value = 0;
+    double m2 = 0;  // sum of squared differences from the mean
+    long long min_value = std::numeric_limits<long long>::max();
+    long long max_value = std::numeric_limits<long long>::min();
+
+public:
+    void add(const long long value) {
+        ++n;
+        sum += value;
+        const double delta = value - mean_value;
+        mean_value += delta / n;
+        m2 += delta * (value - mean_value);
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    uint64_t count() const {
+        return n;
+    }
+
+    long long total() const {
+        return sum;
+    }
+
+    double mean() const {
+        return mean_value;
+    }
+
+    double variance() const {  // sample variance
+        return n > 1 ? m2 / (n - 1) : 0;
+    }
+
+    double stddev() const {
+        return std::sqrt(variance());
+    }
+
+    // half width of the normal confidence interval for the mean, where z = 1.96 gives the 95% interval
+    double mean_half_width(const double z) const {
+        return n > 1 ? z * std::sqrt(variance() / n) : std::numeric_limits<double>::infinity();
+    }
+
+    long long min() const {
+        return n > 0 ? min_value : 0;
+    }
+
+    long long max() const {
+        return n > 0 ? max_value : 0;
+    }
+
+    RunningStats& operator+=(const RunningStats& other) {
+        if (other.n == 0) return *this;
+        const uint64_t total_n = n + other.n;
+        const double delta = other.mean_value - mean_value;
+        m2 += other.m2 + delta * delta * (1.0 * n * other.n / total_n);
+        mean_value += delta * other.n / total_n;
+        n = total_n;
+        sum += other.sum;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+        return *this;
+    }
+};
+
+// RunningStats along with a QuantileSketch for everything else, for values that can't be negative
+class StreamingStats : public RunningStats {
+    QuantileSketch sketch;
+
+public:
+    void add(const long long value) {
+        RunningStats::add(value);
+        sketch.add(std::max(0LL, value));
+    }
+
+    // the sketch gives the middle of a bucket, which can be past the largest (or smallest) value that's actually in it
+    long long quantile(const double q) const {
+        return std::clamp(static_cast<long long>(sketch.quantile(q)), min(), max());
+    }
+
+    double median() const {
+        return std::clamp(sketch.median(), static_cast<double>(min()), static_cast<double>(max()));
+    }
+
+    StreamingStats& operator+=(const StreamingStats& other) {
+        RunningStats::operator+=(other);
+        sketch += other.sketch;
+        return *this;
+    }
+};
+
+#endif
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <memory>
 #include <thread>
+#include <vector>
 #include "util.hpp"
 
 
@@ -33,32 +37,76 @@ namespace heuristics {
     }
 
 
+    // the corner and wall heuristics are all weighted sums over the tiles, maxed over the ways the board can be turned
+    // so each one is stored as a table per row of its weight matrix, where tables[r][row] is the sum of
+    // weights[r][c] * f(tile c of row) and f gives either the tile's value or its exponent
+    // then a single orientation only takes 4 lookups, instead of a shift and a branch for every tile
+    // the entries are 32 bits, so a heuristic's tables take 1MB instead of 2MB; the wall heuristics' weights go up to 2^40,
+    // but every weight in a row shares a power of 2, so that gets taken out of the row's entries and shifted back in
+    struct WeightRows {
+        std::array<std::array<uint32_t, ROWS>, 4> tables;
+        std::array<int, 4> shifts;  // tables[r][row] << shifts[r] is the weighted sum of the row
+    };
+    using WeightMatrix = std::array<std::array<eval_t, 4>, 4>;  // weights[r][c] is the weight of tile_exp(board, r, c)
+
+    constexpr eval_t weighted_row(const std::array<eval_t, 4>& weights, const int row, const bool use_exponent) {
+        eval_t sum = 0;
+        for (int c = 0; c < 4; ++c) {
+            const int exp = (row >> (c << 2)) & 0xF;
+            sum += weights[c] * (use_exponent ? exp : (exp == 0 ? 0 : 1 << exp));
+        }
+        return sum;
+    }
+
+    // every weighted sum of a row is a multiple of the smallest power of 2 in any of its weights
+    constexpr int row_shift(const std::array<eval_t, 4>& weights) {
+        eval_t common = 0;
+        for (const eval_t weight: weights) common |= weight;
+        return common == 0 ? 0 : std::countr_zero(static_cast<uint64_t>(common));
+    }
+
+    // the built-in weights are known to fit, and one that doesn't would fail the check at compile time
+    TABLE_GENERATOR WeightRows gen_weight_rows(const WeightMatrix& weights, const bool use_exponent) {
+        WeightRows rows;
+        for (int r = 0; r < 4; ++r) {
+            rows.shifts[r] = row_shift(weights[r]);
+            for (int row = 0; row < ROWS; ++row) {
+                const eval_t entry = weighted_row(weights[r], row, use_exponent) >> rows.shifts[r];
+                assert(entry <= UINT32_MAX);
+                rows.tables[r][row] = entry;
+            }
+        }
+        return rows;
+    }
+
+    // the tables for the given rows of the board, where row i lines up with row i of the weight matrix
+    inline eval_t weight_sum(const WeightRows& rows, const int row0, const int row1, const int row2, const int row3) {
+        return (static_cast<eval_t>(rows.tables[0][row0]) << rows.shifts[0]) + (static_cast<eval_t>(rows.tables[1][row1]) << rows.shifts[1]) +
+               (static_cast<eval_t>(rows.tables[2][row2]) << rows.shifts[2]) + (static_cast<eval_t>(rows.tables[3][row3]) << rows.shifts[3]);
+    }
+
+    // takes the max over the 4 orientations where rows stay rows: as is, flipped vertically, flipped horizontally, and both
+    // a vertical flip lines up the rows with the weights in the opposite order, and a horizontal flip reverses each row
+    // getting the other 4 orientations (where rows become columns) only needs the same thing on transpose(board)
+    inline eval_t max_row_orientations(const WeightRows& tables, const board_t board) {
+        const int r0 = board & 0xFFFF, r1 = (board >> 16) & 0xFFFF, r2 = (board >> 32) & 0xFFFF, r3 = (board >> 48) & 0xFFFF;
+        const int m0 = reversed[r0], m1 = reversed[r1], m2 = reversed[r2], m3 = reversed[r3];
+        return std::max({weight_sum(tables, r0, r1, r2, r3), weight_sum(tables, r3, r2, r1, r0),
+                         weight_sum(tables, m0, m1, m2, m3), weight_sum(tables, m3, m2, m1, m0)});
+    }
+
     // gives a score based on how the tiles are arranged in the corner, returns max over all 4 corners
     // higher value tiles should be closer to the corner
     // these weights are mostly arbitrary and could do with some tuning
+    // (the weights are symmetric across the diagonal through the corner, so transposing would give the same scores)
+    LOOKUP_TABLE WeightRows corner_rows = gen_weight_rows({{
+        {1, 2, 5, 10},
+        {0, 1, 3, 5},
+        {0, 0, 1, 2},
+        {0, 0, 0, 1},
+    }}, false);
     eval_t corner_heuristic(const board_t board) {
-        const eval_t lower_left =  10 * tile_val(board, 0, 3) + 5 * tile_val(board, 0, 2) + 2 * tile_val(board, 0, 1) + 1 * tile_val(board, 0, 0) +
-                                   5  * tile_val(board, 1, 3) + 3 * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 1) +
-                                   2  * tile_val(board, 2, 3) + 1 * tile_val(board, 2, 2) +
-                                   1  * tile_val(board, 3, 3);
-
-        const eval_t upper_left =  10 * tile_val(board, 3, 3) + 5 * tile_val(board, 3, 2) + 2 * tile_val(board, 3, 1) + 1 * tile_val(board, 3, 0) +
-                                   5  * tile_val(board, 2, 3) + 3 * tile_val(board, 2, 2) + 1 * tile_val(board, 2, 1) +
-                                   2  * tile_val(board, 1, 3) + 1 * tile_val(board, 1, 2) +
-                                   1  * tile_val(board, 0, 3);
-
-        const eval_t lower_right = 10 * tile_val(board, 0, 0) + 5 * tile_val(board, 0, 1) + 2 * tile_val(board, 0, 2) + 1 * tile_val(board, 0, 3) +
-                                   5  * tile_val(board, 1, 0) + 3 * tile_val(board, 1, 1) + 1 * tile_val(board, 1, 2) +
-                                   2  * tile_val(board, 2, 0) + 1 * tile_val(board, 2, 1) +
-                                   1  * tile_val(board, 3, 0);
-
-        const eval_t upper_right = 10 * tile_val(board, 3, 0) + 5 * tile_val(board, 3, 1) + 2 * tile_val(board, 3, 2) + 1 * tile_val(board, 3, 3) +
-                                   5  * tile_val(board, 2, 0) + 3 * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 2) +
-                                   2  * tile_val(board, 1, 0) + 1 * tile_val(board, 1, 1) +
-                                   1  * tile_val(board, 0, 0);
-
-        // using initializer list takes about same time as 3 std::max calls
-        return std::max({lower_left, upper_left, lower_right, upper_right});
+        return max_row_orientations(corner_rows, board);
     }
 
     // compares boards lexicographically, going in a snake across a wall of the board with a gap on the side
@@ -68,33 +116,16 @@ namespace heuristics {
     // 6 7 8 x
     // x x x x
     // takes the maximum over all 4 walls, both transposed and not
-    eval_t _wall_gap_heuristic(const board_t board) {
-        const eval_t top =
-                (tile_exp(board, 3, 3) << 40) | (tile_exp(board, 3, 2) << 36) | (tile_exp(board, 3, 1) << 32) |
-                (tile_exp(board, 2, 3) << 20) | (tile_exp(board, 2, 2) << 24) | (tile_exp(board, 2, 1) << 28) |
-                (tile_exp(board, 1, 3) << 16) | (tile_exp(board, 1, 2) << 12) | (tile_exp(board, 1, 1) << 8);
-
-        const eval_t bottom =
-                (tile_exp(board, 0, 0) << 40) | (tile_exp(board, 0, 1) << 36) | (tile_exp(board, 0, 2) << 32) |
-                (tile_exp(board, 1, 0) << 20) | (tile_exp(board, 1, 1) << 24) | (tile_exp(board, 1, 2) << 28) |
-                (tile_exp(board, 2, 0) << 16) | (tile_exp(board, 2, 1) << 12) | (tile_exp(board, 2, 2) << 8);
-
-        const eval_t left =
-                (tile_exp(board, 0, 3) << 40) | (tile_exp(board, 1, 3) << 36) | (tile_exp(board, 2, 3) << 32) |
-                (tile_exp(board, 0, 2) << 20) | (tile_exp(board, 1, 2) << 24) | (tile_exp(board, 2, 2) << 28) |
-                (tile_exp(board, 0, 1) << 16) | (tile_exp(board, 1, 1) << 12) | (tile_exp(board, 2, 1) << 8);
-
-        const eval_t right =
-                (tile_exp(board, 3, 0) << 40) | (tile_exp(board, 2, 0) << 36) | (tile_exp(board, 1, 0) << 32) |
-                (tile_exp(board, 3, 1) << 20) | (tile_exp(board, 2, 1) << 24) | (tile_exp(board, 1, 1) << 28) |
-                (tile_exp(board, 3, 2) << 16) | (tile_exp(board, 2, 2) << 12) | (tile_exp(board, 1, 2) << 8);
-
-        return std::max({top, bottom, left, right});
-    }
-
+    // each tile's exponent gets shifted into its place in the order, which is the same as multiplying by a power of 2
+    LOOKUP_TABLE WeightRows wall_gap_rows = gen_weight_rows({{
+        {0, 0, 0, 0},
+        {0, 1LL << 8, 1LL << 12, 1LL << 16},
+        {0, 1LL << 28, 1LL << 24, 1LL << 20},
+        {0, 1LL << 32, 1LL << 36, 1LL << 40},
+    }}, true);
     eval_t wall_gap_heuristic(const board_t board) {
-        return std::max(_wall_gap_heuristic(board), _wall_gap_heuristic(transpose(board))) + score_heuristic(board);
-        // tiebreak by score
+        return std::max(max_row_orientations(wall_gap_rows, board), max_row_orientations(wall_gap_rows, transpose(board))) +
+               score_heuristic(board);  // tiebreak by score
     }
 
     // compares boards lexicographically, going in a snake across an entire wall of the board
@@ -104,28 +135,22 @@ namespace heuristics {
     // 8 x x x
     // x x x x
     // takes the maximum over all 4 walls, both transposed and not
+    LOOKUP_TABLE WeightRows full_wall_rows = gen_weight_rows({{
+        {0, 0, 0, 0},
+        {0, 0, 0, 1LL << 8},
+        {1LL << 24, 1LL << 20, 1LL << 16, 1LL << 12},
+        {1LL << 28, 1LL << 32, 1LL << 36, 1LL << 40},
+    }}, true);
     eval_t _full_wall_heuristic(const board_t board) {
-        const eval_t top =
-                (tile_exp(board, 3, 3) << 40) | (tile_exp(board, 3, 2) << 36) | (tile_exp(board, 3, 1) << 32) | (tile_exp(board, 3, 0) << 28) |
-                (tile_exp(board, 2, 3) << 12) | (tile_exp(board, 2, 2) << 16) | (tile_exp(board, 2, 1) << 20) | (tile_exp(board, 2, 0) << 24) |
-                (tile_exp(board, 1, 3) << 8);
-
-        const eval_t bottom =
-                (tile_exp(board, 0, 0) << 40) | (tile_exp(board, 0, 1) << 36) | (tile_exp(board, 0, 2) << 32) | (tile_exp(board, 0, 3) << 28) |
-                (tile_exp(board, 1, 0) << 12) | (tile_exp(board, 1, 1) << 16) | (tile_exp(board, 1, 2) << 20) | (tile_exp(board, 0, 3) << 24) |
-                (tile_exp(board, 2, 0) << 8);
-
-        const eval_t left =
-                (tile_exp(board, 0, 3) << 40) | (tile_exp(board, 1, 3) << 36) | (tile_exp(board, 2, 3) << 32) | (tile_exp(board, 3, 3) << 28) |
-                (tile_exp(board, 0, 2) << 12) | (tile_exp(board, 1, 2) << 16) | (tile_exp(board, 2, 2) << 20) | (tile_exp(board, 3, 2) << 24) |
-                (tile_exp(board, 0, 1) << 8);
-
-        const eval_t right =
-                (tile_exp(board, 3, 0) << 40) | (tile_exp(board, 2, 0) << 36) | (tile_exp(board, 1, 0) << 32) | (tile_exp(board, 0, 0) << 28) |
-                (tile_exp(board, 3, 1) << 12) | (tile_exp(board, 2, 1) << 16) | (tile_exp(board, 1, 1) << 20) | (tile_exp(board, 0, 1) << 24) |
-                (tile_exp(board, 3, 2) << 8);
-
-        return std::max({top, bottom, left, right});
+        const int r0 = board & 0xFFFF, r1 = (board >> 16) & 0xFFFF, r2 = (board >> 32) & 0xFFFF, r3 = (board >> 48) & 0xFFFF;
+        const int m0 = reversed[r0], m1 = reversed[r1], m2 = reversed[r2], m3 = reversed[r3];
+
+        // the wall along the bottom has always counted tile (0, 3) in place of tile (1, 3) for 7 in the order
+        // this makes the heuristic slightly asymmetric, but it's kept so that results stay comparable
+        const eval_t bottom_fix = (static_cast<eval_t>(tile_exp(board, 0, 3)) - static_cast<eval_t>(tile_exp(board, 1, 3))) << 24;
+
+        return std::max({weight_sum(full_wall_rows, r0, r1, r2, r3), weight_sum(full_wall_rows, r3, r2, r1, r0),
+                         weight_sum(full_wall_rows, m0, m1, m2, m3), weight_sum(full_wall_rows, m3, m2, m1, m0) + bottom_fix});
     }
 
     eval_t full_wall_heuristic(const board_t board) {
@@ -201,36 +226,14 @@ namespace heuristics {
     }
 
     // similar to corner_heuristic but with different weights
-    eval_t _skewed_corner_heuristic(const board_t board) {
-        const eval_t top =
-                16 * tile_val(board, 3, 3) + 10 * tile_val(board, 3, 2) + 6 * tile_val(board, 3, 1) + 3 * tile_val(board, 3, 0) +
-                10 * tile_val(board, 2, 3) + 6  * tile_val(board, 2, 2) + 3 * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 0) +
-                4  * tile_val(board, 1, 3) + 3  * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 1) +
-                1  * tile_val(board, 0, 3) + 1  * tile_val(board, 0, 2);
-
-        const eval_t bottom =
-                16 * tile_val(board, 0, 0) + 10 * tile_val(board, 0, 1) + 6 * tile_val(board, 0, 2) + 3 * tile_val(board, 0, 3) +
-                10 * tile_val(board, 1, 0) + 6  * tile_val(board, 1, 1) + 3 * tile_val(board, 1, 2) + 1 * tile_val(board, 1, 3) +
-                4  * tile_val(board, 2, 0) + 3  * tile_val(board, 2, 1) + 1 * tile_val(board, 2, 2) +
-                1  * tile_val(board, 3, 0) + 1  * tile_val(board, 3, 1);
-
-        const eval_t left =
-                16 * tile_val(board, 0, 3) + 10 * tile_val(board, 1, 3) + 6 * tile_val(board, 2, 3) + 3 * tile_val(board, 3, 3) +
-                10 * tile_val(board, 0, 2) + 6  * tile_val(board, 1, 2) + 3 * tile_val(board, 2, 2) + 1 * tile_val(board, 3, 2) +
-                4  * tile_val(board, 0, 1) + 3  * tile_val(board, 1, 1) + 1 * tile_val(board, 2, 1) +
-                1  * tile_val(board, 0, 0) + 1  * tile_val(board, 1, 0);
-
-        const eval_t right =
-                16 * tile_val(board, 3, 0) + 10 * tile_val(board, 2, 0) + 6 * tile_val(board, 1, 0) + 3 * tile_val(board, 0, 0) +
-                10 * tile_val(board, 3, 1) + 6  * tile_val(board, 2, 1) + 3 * tile_val(board, 1, 1) + 1 * tile_val(board, 0, 1) +
-                4  * tile_val(board, 3, 2) + 3  * tile_val(board, 2, 2) + 1 * tile_val(board, 1, 2) +
-                1  * tile_val(board, 3, 3) + 1  * tile_val(board, 2, 3);
-
-        return std::max({top, bottom, left, right});
-    }
-
+    LOOKUP_TABLE WeightRows skewed_corner_rows = gen_weight_rows({{
+        {0, 0, 1, 1},
+        {0, 1, 3, 4},
+        {1, 3, 6, 10},
+        {3, 6, 10, 16},
+    }}, false);
     eval_t skewed_corner_heuristic(const board_t board) {
-        return std::max(_skewed_corner_heuristic(board), _skewed_corner_heuristic(transpose(board)));
+        return std::max(max_row_orientations(skewed_corner_rows, board), max_row_orientations(skewed_corner_rows, transpose(board)));
     }
 
     // duplicate tiles are only counted if they're not right next to each other
@@ -249,7 +252,7 @@ namespace heuristics {
 
     // generates monotonicity scores for each row
     // rows with larger tiles receive higher scores but also larger penalties in the case where the row isn't monotonic
-    consteval std::array<eval_t, ROWS> gen_monotonicity() {
+    TABLE_GENERATOR std::array<eval_t, ROWS> gen_monotonicity() {
         std::array<eval_t, ROWS> monotonicity;
         for (int row = 0; row < ROWS; ++row) {
             const int r[4] = {(row >> 12) & 0xF, (row >> 8) & 0xF, (row >> 4) & 0xF, row & 0xF};
@@ -267,7 +270,7 @@ namespace heuristics {
         return monotonicity;
     }
 
-    constexpr std::array<eval_t, ROWS> monotonicity = gen_monotonicity();
+    LOOKUP_TABLE std::array<eval_t, ROWS> monotonicity = gen_monotonicity();
     eval_t monotonicity_heuristic(const board_t board) {
         const board_t transposed_board = transpose(board);
         return std::max(0LL,  // all evaluations should be non-negative
@@ -284,7 +287,84 @@ namespace heuristics {
                count_empty(to_tile_mask(board));  // if things go bad and the main heuristic becomes 0, the best way to fix it is to clear up the board
     }
 
-    constexpr heuristic_t exports[8] = {
+    // heuristics that are made at runtime, either from a weight matrix or from a rule for scoring rows
+    // they get tables in the same layout as the built-in ones above, so they're evaluated just as fast
+    // heuristic_t is a plain function pointer, so the tables go in one of a few fixed slots instead of in the heuristic
+    constexpr int CUSTOM_SLOTS = 4;
+
+    struct CustomHeuristic {
+        std::unique_ptr<WeightRows> tables;  // only allocated once the slot is used, since each slot takes 1MB
+        bool use_transpose = false;
+    };
+    inline CustomHeuristic custom_heuristics[CUSTOM_SLOTS];
+
+    // a slot that hasn't been set up scores every board as MIN_EVAL, so that a strategy made with it (like from an index
+    // that came from JS or Python) plays without a heuristic instead of crashing, and picks it up once the slot is set
+    inline eval_t custom_score(const CustomHeuristic& custom, const board_t board) {
+        if (custom.tables == nullptr) return MIN_EVAL;
+        const eval_t score = max_row_orientations(*custom.tables, board);
+        return custom.use_transpose ? std::max(score, max_row_orientations(*custom.tables, transpose(board))) : score;
+    }
+
+    template<int slot>
+    eval_t custom_heuristic(const board_t board) {
+        return custom_score(custom_heuristics[slot], board);
+    }
+
+    constexpr heuristic_t custom_slots[CUSTOM_SLOTS] = {
+        custom_heuristic<0>,
+        custom_heuristic<1>,
+        custom_heuristic<2>,
+        custom_heuristic<3>,
+    };
+
+    // builds a heuristic where rule(r, row) scores a 16-bit row when it's in row r of the board
+    // the score of a board is the sum over its rows, maxed over the orientations in max_row_orientations,
+    // and also over the transposed board if use_transpose is set
+    // replaces whatever was in the slot before, so the slot can't be changed while something is searching with it
+    // returns nullptr if the slot doesn't exist, or if some board would score outside of [MIN_EVAL, MAX_EVAL],
+    // since the searches depend on that range, or if a row's scores are too far apart to fit in the 32-bit tables
+    // the slot comes straight from the demos' JS and Python, so it's checked even in release builds
+    template<class RowRule>
+    heuristic_t make_row_heuristic(const int slot, const RowRule& rule, const bool use_transpose) {
+        if (slot < 0 || slot >= CUSTOM_SLOTS) return nullptr;
+        auto tables = std::make_unique<WeightRows>();
+        std::vector<eval_t> scores(ROWS);
+        eval_t max_sum = 0;
+        for (int r = 0; r < 4; ++r) {
+            eval_t max_row = MIN_EVAL;
+            eval_t common = 0;
+            for (int row = 0; row < ROWS; ++row) {
+                scores[row] = rule(r, row);
+                if (scores[row] < MIN_EVAL || scores[row] > MAX_EVAL) return nullptr;
+                max_row = std::max(max_row, scores[row]);
+                common |= scores[row];
+            }
+            max_sum += max_row;
+
+            const int shift = common == 0 ? 0 : std::countr_zero(static_cast<uint64_t>(common));
+            if ((max_row >> shift) > UINT32_MAX) return nullptr;
+            tables->shifts[r] = shift;
+            for (int row = 0; row < ROWS; ++row) tables->tables[r][row] = scores[row] >> shift;
+        }
+        if (max_sum > MAX_EVAL) return nullptr;
+
+        custom_heuristics[slot] = {std::move(tables), use_transpose};
+        return custom_slots[slot];
+    }
+
+    // builds a heuristic like corner_heuristic, where weights[r][c] multiplies tile (r, c)
+    // by its value, or by its exponent if use_exponent is set (which lets weights that are powers of 2 order tiles like the wall heuristics)
+    heuristic_t make_weight_heuristic(const int slot, const WeightMatrix& weights, const bool use_exponent, const bool use_transpose) {
+        return make_row_heuristic(slot, [&weights, use_exponent](const int r, const int row) {
+            return weighted_row(weights[r], row, use_exponent);
+        }, use_transpose);
+    }
+
+    // the custom slots come last, so that they can be picked by index like everything else
+    // each one has to be set up with make_row_heuristic or make_weight_heuristic before it's used
+    constexpr int FIRST_CUSTOM_EXPORT = 8;
+    constexpr heuristic_t exports[FIRST_CUSTOM_EXPORT + CUSTOM_SLOTS] = {
         score_heuristic,
         merge_heuristic,
         corner_heuristic,
@@ -293,5 +373,85 @@ namespace heuristics {
         strict_wall_heuristic,
         skewed_corner_heuristic,
         monotonicity_heuristic,
+        custom_heuristic<0>,
+        custom_heuristic<1>,
+        custom_heuristic<2>,
+        custom_heuristic<3>,
+    };
+
+    eval_t no_heuristic(const board_t) {
+        return MIN_EVAL;
+    }
+
+    // the heuristic at index idx of exports, for the strategies' constructors that take an index
+    // indices can come straight from the demos' JS and Python, so one that's out of range gets no_heuristic,
+    // which plays the same way as an unset custom slot
+    heuristic_t exported(const int idx) {
+        return 0 <= idx && idx < static_cast<int>(std::size(exports)) ? exports[idx] : no_heuristic;
+    }
+
+    // whether the heuristic gives the same value for all 8 symmetries of every board, which canonical cache keys depend on
+    // full_wall_heuristic is the only exported one that doesn't, and a custom slot only does if it uses the transpose
+    // (and even then only as long as the slot isn't set up again with a different heuristic)
+    // anything that isn't exported is assumed not to be
+    bool is_symmetric(const heuristic_t heuristic) {
+        for (int i = 0; i < FIRST_CUSTOM_EXPORT; ++i) {
+            if (heuristic == exports[i]) return heuristic != full_wall_heuristic;
+        }
+        for (int slot = 0; slot < CUSTOM_SLOTS; ++slot) {
+            if (heuristic == custom_slots[slot]) return custom_heuristics[slot].use_transpose;
+        }
+        return false;
+    }
+
+    // evaluator policies for the searches, which are anything that can be called like a heuristic_t
+    // a search instantiated with InlineHeuristic can inline the heuristic into its leaves instead of making an indirect call
+    // at each one, CustomRows does the same for all of the custom slots at once, and HeuristicPointer is the fallback
+    template<heuristic_t heuristic>
+    struct InlineHeuristic {
+        eval_t operator()(const board_t board) const {
+            return heuristic(board);
+        }
+    };
+
+    struct CustomRows {
+        const CustomHeuristic& custom;
+
+        eval_t operator()(const board_t board) const {
+            return custom_score(custom, board);
+        }
     };
+
+    struct HeuristicPointer {
+        const heuristic_t heuristic;
+
+        eval_t operator()(const board_t board) const {
+            return heuristic(board);
+        }
+    };
+
+    // the row table heuristics are only a few loads and adds, so the indirect call is a big part of what they cost
+    // the others are slow enough (or simple enough to be rarely used) that they don't gain enough to be worth a copy
+    constexpr heuristic_t inlined_heuristics[] = {
+        corner_heuristic,
+        wall_gap_heuristic,
+        full_wall_heuristic,
+        skewed_corner_heuristic,
+    };
+
+    // calls visit with the evaluator for the heuristic, which is an InlineHeuristic for anything in inlined_heuristics
+    // strategies only do this once per move, but every evaluator gets its own copy of the whole search,
+    // so everything other than the row table heuristics shares the HeuristicPointer copy
+    template<size_t i = 0, class Visitor>
+    auto with_evaluator(const heuristic_t heuristic, const Visitor& visit) {
+        if constexpr (i == std::size(inlined_heuristics)) {
+            for (int slot = 0; slot < CUSTOM_SLOTS; ++slot) {
+                if (heuristic == custom_slots[slot]) return visit(CustomRows{custom_heuristics[slot]});
+            }
+            return visit(HeuristicPointer{heuristic});
+        } else {
+            if (heuristic == inlined_heuristics[i]) return visit(InlineHeuristic<inlined_heuristics[i]>{});
+            return with_evaluator<i + 1>(heuristic, visit);
+        }
+    }
 }
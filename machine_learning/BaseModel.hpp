@@ -36,9 +36,11 @@ public:
     const int pick_move(const board_t board) const {
         int best_move = -1;
         float best_score = 0;
+        board_t after_boards[4];
+        const int legal = make_moves(board, after_boards);
         for (int i = 0; i < 4; ++i) {
-            const board_t after_board = make_move(board, i);
-            if (board == after_board) continue;
+            if (((legal >> i) & 1) == 0) continue;
+            const board_t after_board = after_boards[i];
 
             const int reward = calculate_reward(board, after_board);
             const float eval = reward + evaluate(after_board);
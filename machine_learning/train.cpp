@@ -9,6 +9,7 @@
 #include "DoubleTD0.hpp"
 #include "ExportedTD0.hpp"
 #include "TD0.hpp"
+#include "../game_stats.hpp"
 
 constexpr double LEARNING_RATE = 0.001;
 constexpr int EPOCHS = 2000;
@@ -17,14 +18,13 @@ static_assert(EPOCHS % SAVE_INTERVAL == 0);
 
 constexpr int TRAIN_GAMES = 10000;
 constexpr int TEST_GAMES = 100000;
-constexpr int MAX_GAMES = std::max(TRAIN_GAMES, TEST_GAMES);
 
 constexpr int MIN_TILE = 3;   // getting 2^3 should always be guaranteed
 constexpr int MAX_TILE = 15;
 
 int results[MAX_TILE + 1];
-int moves[MAX_GAMES];
-int scores[MAX_GAMES];
+StreamingStats moves;
+StreamingStats scores;
 
 #ifdef TESTING
 std::unique_ptr<BaseModel> model(TD0::best_model);
@@ -32,22 +32,10 @@ std::unique_ptr<BaseModel> model(TD0::best_model);
 std::unique_ptr<BaseModel> model(new TD0(MAX_TILE + 1, LEARNING_RATE));
 #endif
 
-float calculate_average(const int arr[], const int n) {
-    long long sum = 0;
-    for (int i = 0; i < n; ++i) sum += arr[i];
-    return float(sum) / n;
-}
-
-float calculate_median(const int arr[], const int n) {  // if n is even, returns mean of two middle elements
-    std::vector<int> tmp(arr, arr + n);
-    sort(tmp.begin(), tmp.end());
-    return (n & 1) ? tmp[n / 2] : (tmp[(n - 1) / 2] + tmp[n / 2]) / 2.0;
-}
-
 void clear_results() {
     std::fill(results, results + MAX_TILE + 1, 0);
-    std::fill(moves, moves + MAX_GAMES, 0);
-    std::fill(scores, scores + MAX_GAMES, 0);
+    moves = StreamingStats();
+    scores = StreamingStats();
 }
 
 void print_results(const int games) {
@@ -55,8 +43,8 @@ void print_results(const int games) {
     for (int i = MIN_TILE; i <= MAX_TILE; ++i) {
         std::cout << i << ' ' << results[i] << " (" << 100.0 * results[i] / games << ')' << std::endl;
     }
-    std::cout << "Moves: " << calculate_average(moves, games) << ' ' << calculate_median(moves, games) << std::endl;
-    std::cout << "Score: " << calculate_average(scores, games) << ' ' << calculate_median(scores, games) << std::endl;
+    std::cout << "Moves: " << moves.mean() << ' ' << moves.median() << std::endl;
+    std::cout << "Score: " << scores.mean() << ' ' << scores.median() << std::endl;
 }
 
 void play_games(const bool train, const int games) {
@@ -68,8 +56,8 @@ void play_games(const bool train, const int games) {
 
         ++results[max_tile];
 
-        moves[i] = count_moves_made(board, fours);
-        scores[i] = actual_score(board, fours);
+        moves.add(count_moves_made(board, fours));
+        scores.add(actual_score(board, fours));
     }
     print_results(games);
     clear_results();
@@ -0,0 +1,238 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "game.hpp"
+#include "util.hpp"
+
+// GameSimulator::play reports every spawn and move to a record object, which only needs two functions:
+//     add_spawn(position, tile_val): one of the two tiles that start the game
+//     add_turn(move, position, tile_val): a move, followed by the tile that spawned after it
+// position is the bit offset of the tile (a multiple of 4), and tile_val is 1 for a 2 and 2 for a 4
+
+// the packed format uses one byte for each of these:
+//     bits 0-1: move (0=left, 1=up, 2=right, 3=down), always 0 for an opening spawn
+//     bits 2-5: which tile the new tile spawned on
+//     bit 6: set if the new tile was a 4
+//     bit 7: set for the two opening spawns, which don't have a move
+// a game always makes at least one move, so a new game starts wherever an opening spawn follows a turn
+// this lets any number of games be written back to back without any headers
+static constexpr uint8_t RECORD_OPENING = 0x80;
+static constexpr uint8_t RECORD_FOUR = 0x40;
+
+constexpr uint8_t encode_spawn(const int position, const board_t tile_val) {
+    return RECORD_OPENING | ((position >> 2) << 2) | (tile_val == 2 ? RECORD_FOUR : 0);
+}
+
+constexpr uint8_t encode_turn(const int move, const int position, const board_t tile_val) {
+    return move | ((position >> 2) << 2) | (tile_val == 2 ? RECORD_FOUR : 0);
+}
+
+// doesn't store anything, only keeps the counts that the tester needs
+// this replaces scanning the old text records for uppercase letters after each game
+class GameCounter {
+public:
+    int fours = 0;
+    int moves = 0;
+
+    void add_spawn(const int, const board_t tile_val) {
+        fours += tile_val == 2;
+    }
+
+    void add_turn(const int, const int, const board_t tile_val) {
+        fours += tile_val == 2;
+        ++moves;
+    }
+
+    int score(const board_t final_board) const {
+        return actual_score(final_board, fours);
+    }
+};
+
+// the old human-readable record: a lowercase move (l, u, r, d) and then the spawn's row as a letter,
+// where a-d is a 2 and A-D is a 4
+class TextRecord : public GameCounter {
+    static constexpr std::array<char, 4> MOVES = {'l', 'u', 'r', 'd'};
+
+public:
+    std::string text;
+
+    TextRecord() {
+        text.reserve(6000);  // enough for almost 3000 moves. should be enough for most games
+    }
+
+    void add_spawn(const int position, const board_t tile_val) {
+        GameCounter::add_spawn(position, tile_val);
+        text.push_back((position / 4) + (tile_val == 1 ? 'a' : 'A'));
+    }
+
+    void add_turn(const int move, const int position, const board_t tile_val) {
+        GameCounter::add_turn(move, position, tile_val);
+        text.push_back(MOVES[move]);
+        text.push_back((position / 4) + (tile_val == 1 ? 'a' : 'A'));
+    }
+};
+
+// streams packed records for any number of games, buffering them so that the destination sees large blocks
+// subclasses decide where the blocks go; the counts only cover the game since the last start_game()
+class RecordWriter : public GameCounter {
+    static constexpr int BUFFER_SIZE = 1 << 16;
+
+    uint8_t buffer[BUFFER_SIZE];
+    int buffer_size = 0;
+
+    void push(const uint8_t entry) {
+        buffer[buffer_size++] = entry;
+        if (buffer_size == BUFFER_SIZE) flush();
+    }
+
+protected:
+    virtual void write_block(const uint8_t* data, const size_t size) = 0;
+
+public:
+    virtual ~RecordWriter() = default;
+
+    void start_game() {
+        fours = moves = 0;
+    }
+
+    void add_spawn(const int position, const board_t tile_val) {
+        GameCounter::add_spawn(position, tile_val);
+        push(encode_spawn(position, tile_val));
+    }
+
+    void add_turn(const int move, const int position, const board_t tile_val) {
+        GameCounter::add_turn(move, position, tile_val);
+        push(encode_turn(move, position, tile_val));
+    }
+
+    void flush() {
+        if (buffer_size > 0) write_block(buffer, buffer_size);
+        buffer_size = 0;
+    }
+};
+
+class StreamRecordWriter : public RecordWriter {
+    std::ostream& out;
+
+protected:
+    void write_block(const uint8_t* data, const size_t size) override {
+        out.write(reinterpret_cast<const char*>(data), size);
+    }
+
+public:
+    StreamRecordWriter(std::ostream& _out) : out(_out) {}
+
+    ~StreamRecordWriter() override {
+        flush();
+    }
+};
+
+#ifdef HAS_MMAP
+// writes into a memory-mapped file, which is grown in large steps and trimmed to size once the writer is destroyed
+// the kernel writes the pages back on its own time, so the games don't have to wait on file writes
+class MappedRecordWriter : public RecordWriter {
+    static constexpr size_t GROWTH = 1 << 26;  // 64MB, about 250k games of a decent strategy
+
+    int fd;
+    uint8_t* mapping = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+
+    void reserve(const size_t needed) {
+        if (needed <= capacity) return;
+        if (mapping != nullptr) munmap(mapping, capacity);
+
+        capacity = std::max(capacity + GROWTH, needed);
+        [[maybe_unused]] const int result = ftruncate(fd, capacity);
+        assert(result == 0);
+        mapping = static_cast<uint8_t*>(mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        assert(mapping != MAP_FAILED);
+    }
+
+protected:
+    void write_block(const uint8_t* data, const size_t block_size) override {
+        reserve(size + block_size);
+        std::memcpy(mapping + size, data, block_size);
+        size += block_size;
+    }
+
+public:
+    MappedRecordWriter(const std::string& filename) {
+        fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(fd != -1);  // might need to create the directory if this doesn't work
+    }
+
+    ~MappedRecordWriter() override {
+        flush();
+        if (mapping != nullptr) munmap(mapping, capacity);
+        [[maybe_unused]] const int result = ftruncate(fd, size);
+        assert(result == 0);
+        close(fd);
+    }
+};
+#endif
+
+std::vector<uint8_t> read_record_file(const std::string& filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    assert(fin.is_open());
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+// replays packed records back into boards, one game at a time
+class RecordReader {
+    const GameSimulator simulator{0};  // only used for making moves, so the seed doesn't matter
+    const uint8_t* data;
+    const size_t size;
+    size_t pos = 0;
+
+public:
+    RecordReader(const uint8_t* _data, const size_t _size) : data(_data), size(_size) {}
+
+    RecordReader(const std::vector<uint8_t>& records) : RecordReader(records.data(), records.size()) {}
+
+    // replays the next game, calling on_turn(board) with the board after each move and its spawn
+    // the counter gets the same counts the game had when it was played
+    // returns the final board, or 0 once there are no games left
+    template<class Callback>
+    board_t next_game(GameCounter& counter, Callback on_turn) {
+        board_t board = 0;
+        while (pos < size && (data[pos] & RECORD_OPENING)) {
+            const int position = (data[pos] >> 2 & 0xF) << 2;
+            const board_t tile_val = (data[pos] & RECORD_FOUR) ? 2 : 1;
+            counter.add_spawn(position, tile_val);
+            board |= tile_val << position;
+            ++pos;
+        }
+        while (pos < size && (data[pos] & RECORD_OPENING) == 0) {
+            const int move = data[pos] & 3;
+            const int position = (data[pos] >> 2 & 0xF) << 2;
+            const board_t tile_val = (data[pos] & RECORD_FOUR) ? 2 : 1;
+            counter.add_turn(move, position, tile_val);
+            board = simulator.make_move(board, move);
+            assert(((board >> position) & 0xF) == 0);  // the spawn has to land on an empty tile
+            board |= tile_val << position;
+            on_turn(board);
+            ++pos;
+        }
+        return board;
+    }
+
+    board_t next_game(GameCounter& counter) {
+        return next_game(counter, [](const board_t) {});
+    }
+};
+
+#endif
@@ -4,7 +4,10 @@
 
 import csv
 import itertools
+import math
 import os
+import struct
+import sys
 
 STAGE = "stage3"
 HEURISTICS = ["merge", "score", "corner", "full_wall", "wall_gap"]
@@ -26,6 +29,105 @@ TOTAL_MOVES = 20
 
 DECIMALS = 4
 
+# run with --rebuild to first rebuild every CSV that has a game log (see game_log.hpp) from the log
+# the time taken isn't in the log, so it's left empty, and the quantiles are exact instead of from tester.cpp's sketches
+LOG_HEADER = struct.Struct("<8sII")
+CONFIG_ENTRY = struct.Struct("<IIQII72s")
+GAME_ENTRY = struct.Struct("<IIQIIIIqq")
+CONFIG, GAME = 1, 2
+MIN_TILE, MAX_TILE = 3, 16
+STOP_TILES = [11, 12, 13]
+CONFIDENCE_Z = 1.96
+LOG_CSV_HEADINGS = ["Strategy", "Games", "Time Taken", "Computation Time"] + \
+                   [str(1 << i) for i in range(MIN_TILE, MAX_TILE + 1)] + \
+                   ["Total Score", "Median Score", "Total Moves", "Median Moves",
+                    "Score P10", "Score P90", "Score P99", "Moves P10", "Moves P90", "Moves P99",
+                    "Move Time P50", "Move Time P90", "Move Time P99",
+                    "Stop Reason", "2048 Rate Half Width", "4096 Rate Half Width", "8192 Rate Half Width", "Mean Score Half Width"]
+
+
+def read_game_log(log_filename):
+    with open(log_filename, "rb") as log_file:
+        data = log_file.read()
+    if len(data) < LOG_HEADER.size:
+        return [], {}
+    magic, version, _ = LOG_HEADER.unpack_from(data, 0)
+    assert magic == b"2048log\0" and version == 1, f"{log_filename} isn't a game log"
+
+    configs = []  # (name, games) in the order they were logged
+    games = {}  # config id -> {game index -> (max tile, score, moves, time in ns)}
+    pos = LOG_HEADER.size
+    while pos + 4 <= len(data):
+        kind = struct.unpack_from("<I", data, pos)[0]
+        entry = CONFIG_ENTRY if kind == CONFIG else GAME_ENTRY
+        if kind not in (CONFIG, GAME) or pos + entry.size > len(data):
+            break  # a write that didn't finish
+        fields = entry.unpack_from(data, pos)
+        pos += entry.size
+        if kind == CONFIG:
+            configs.append((fields[5].split(b"\0")[0].decode(), fields[3]))
+        else:
+            games.setdefault(fields[1], {})[fields[3]] = fields[4:8]
+    return configs, games
+
+
+def quantile(values, q):  # nearest rank, like QuantileSketch
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def median(values):
+    return (values[(len(values) - 1) // 2] + values[len(values) // 2]) / 2
+
+
+def rate_half_width(reached, games):  # Wilson score interval, like tester.cpp
+    rate = reached / games
+    z2 = CONFIDENCE_Z * CONFIDENCE_Z
+    return CONFIDENCE_Z * math.sqrt(rate * (1 - rate) / games + z2 / (4 * games * games)) / (1 + z2 / games)
+
+
+def score_half_width(scores):
+    if len(scores) < 2 or sum(scores) == 0:
+        return 1
+    mean = sum(scores) / len(scores)
+    variance = sum((score - mean) ** 2 for score in scores) / (len(scores) - 1)
+    return CONFIDENCE_Z * math.sqrt(variance / len(scores)) / mean
+
+
+def rebuild_csv(log_filename, csv_filename):
+    configs, games = read_game_log(log_filename)
+
+    rows = []
+    for config_id, (name, max_games) in enumerate(configs):
+        played = list(games.get(config_id, {}).values())
+        if not played:
+            continue
+        max_tiles = [game[0] for game in played]
+        scores = sorted(game[1] for game in played)
+        moves = sorted(game[2] for game in played)
+        move_times = sorted(game[3] // game[2] for game in played if game[2] > 0)
+
+        row = [name, len(played), "", sum(game[3] for game in played) / 1e9]
+        row += [sum(max_tile >= i for max_tile in max_tiles) for i in range(MIN_TILE, MAX_TILE + 1)]
+        row += [sum(scores), median(scores), sum(moves), median(moves)]
+        row += [quantile(values, q) for values in (scores, moves) for q in (0.1, 0.9, 0.99)]
+        row += [quantile(move_times, q) / 1e3 if move_times else 0 for q in (0.5, 0.9, 0.99)]
+        row.append("games" if len(played) == max_games else "incomplete")
+        row += [rate_half_width(sum(max_tile >= tile for max_tile in max_tiles), len(played)) for tile in STOP_TILES]
+        row.append(score_half_width(scores))
+        rows.append(row)
+
+    with open(csv_filename, 'w') as csv_file:
+        writer = csv.writer(csv_file)
+        writer.writerow(LOG_CSV_HEADINGS)
+        writer.writerows(rows)
+
+
+if "--rebuild" in sys.argv:
+    for csv_filename in RESULT_FILES:
+        log_filename = csv_filename.removesuffix(".csv") + ".games"
+        if os.path.exists(log_filename):
+            rebuild_csv(log_filename, csv_filename)
+
 for csv_filename in RESULT_FILES:
     filename = os.fsdecode(csv_filename)
 
@@ -1,4 +1,4 @@
-clang++ -std=c++20 -O3 -Wall -pthread -funroll-loops -flto -mcpu=native -fconstexpr-steps=0x600000 tester.cpp -o tester.out \
+clang++ -std=c++20 -O3 -Wall -pthread -funroll-loops -flto -mcpu=native tester.cpp -o tester.out \
 -DTESTING
 
 echo "Compiled tester.cpp!"
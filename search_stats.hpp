@@ -0,0 +1,148 @@
+#ifndef SEARCH_STATS_HPP
+#define SEARCH_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+// counts what the searches do, so that a change can be checked for whether it made the search itself faster,
+// or if it just searched less (for example by moving the depth picker)
+// nothing is counted unless SEARCH_STATS is defined (before any includes); otherwise every method is empty and
+// the counting compiles away entirely
+// the parallel search counts from several threads at once, so counting uses relaxed atomic adds,
+// which means searches are a bit slower with SEARCH_STATS defined
+class SearchStats {
+public:
+    static constexpr int DEPTHS = 16;
+    using clock = std::chrono::steady_clock;
+
+#ifdef SEARCH_STATS
+    static constexpr bool enabled = true;
+
+    long long nodes[DEPTHS] = {};  // positions the search picks a move for, by how many moves it still looks ahead
+    long long leaves = 0;  // heuristic evaluations
+    long long game_over_checks = 0;
+
+    long long cache_probes = 0;
+    long long cache_hits = 0;  // probes that found the board, even if the result turned out to be too shallow to use
+    long long cache_overwrites = 0;  // stores that replaced a result for the same board
+    long long cache_evictions = 0;  // stores that replaced a result for a different board
+    long long cache_occupancy = 0;  // entries this strategy has filled since its cache was last cleared
+    long long max_cache_occupancy = 0;
+
+    long long moves = 0;
+    long long move_time = 0;  // total time spent in pick_move, in nanoseconds
+    long long max_move_time = 0;
+
+private:
+    static void add(long long& counter, const long long amount = 1) {
+        std::atomic_ref<long long>(counter).fetch_add(amount, std::memory_order_relaxed);
+    }
+
+public:
+    void count_node(const int depth) {
+        add(nodes[std::clamp(depth, 0, DEPTHS - 1)]);
+    }
+
+    void count_leaf() {
+        add(leaves);
+    }
+
+    void count_game_over_check() {
+        add(game_over_checks);
+    }
+
+    void count_probe(const bool hit) {
+        add(cache_probes);
+        if (hit) add(cache_hits);
+    }
+
+    void count_store(const bool was_empty, const bool same_board) {
+        if (was_empty) add(cache_occupancy);
+        else if (same_board) add(cache_overwrites);
+        else add(cache_evictions);
+    }
+
+    void count_cache_clear() {
+        std::atomic_ref<long long>(cache_occupancy).store(0, std::memory_order_relaxed);
+    }
+
+    clock::time_point start_move() const {
+        return clock::now();
+    }
+
+    // only the thread playing the game calls this, so the max counters don't need to be atomic
+    void end_move(const clock::time_point start_time) {
+        const long long time_taken = (clock::now() - start_time) / std::chrono::nanoseconds(1);
+        ++moves;
+        move_time += time_taken;
+        max_move_time = std::max(max_move_time, time_taken);
+        max_cache_occupancy = std::max(max_cache_occupancy, std::atomic_ref<long long>(cache_occupancy).load(std::memory_order_relaxed));
+    }
+
+    long long total_nodes() const {
+        long long total = 0;
+        for (int i = 0; i < DEPTHS; ++i) total += nodes[i];
+        return total;
+    }
+
+    // cache_occupancy is left alone, since it only means something for a single cache
+    SearchStats& operator+=(const SearchStats& other) {
+        for (int i = 0; i < DEPTHS; ++i) nodes[i] += other.nodes[i];
+        leaves += other.leaves;
+        game_over_checks += other.game_over_checks;
+        cache_probes += other.cache_probes;
+        cache_hits += other.cache_hits;
+        cache_overwrites += other.cache_overwrites;
+        cache_evictions += other.cache_evictions;
+        max_cache_occupancy = std::max(max_cache_occupancy, other.max_cache_occupancy);
+        moves += other.moves;
+        move_time += other.move_time;
+        max_move_time = std::max(max_move_time, other.max_move_time);
+        return *this;
+    }
+
+    void print(std::ostream& out) const {
+        if (moves == 0) return;  // strategies that don't search never call end_move either
+
+        out << "Search: " << moves << " moves, " << move_time / 1e3 / moves << "us per move (max " << max_move_time / 1e3 << "us)\n";
+        out << "Nodes per move by depth:";
+        for (int i = DEPTHS - 1; i >= 0; --i) {
+            if (nodes[i] > 0) out << ' ' << i << ':' << 1.0 * nodes[i] / moves;
+        }
+        out << "\nLeaf evaluations per move: " << 1.0 * leaves / moves
+            << ", game over checks per move: " << 1.0 * game_over_checks / moves << '\n';
+        if (cache_probes > 0) {
+            out << "Cache: " << cache_hits << '/' << cache_probes << " hits (" << 100.0 * cache_hits / cache_probes << "%), "
+                << cache_overwrites << " overwrites, " << cache_evictions << " evictions, max occupancy " << max_cache_occupancy << '\n';
+        }
+        out << std::flush;
+    }
+#else
+    static constexpr bool enabled = false;
+
+    void count_node(const int) {}
+    void count_leaf() {}
+    void count_game_over_check() {}
+    void count_probe(const bool) {}
+    void count_store(const bool, const bool) {}
+    void count_cache_clear() {}
+
+    int start_move() const {
+        return 0;
+    }
+    void end_move(const int) {}
+
+    long long total_nodes() const {
+        return 0;
+    }
+
+    SearchStats& operator+=(const SearchStats&) {
+        return *this;
+    }
+    void print(std::ostream&) const {}
+#endif
+};
+
+#endif
@@ -2,67 +2,188 @@
 #define EXPECTIMAX_DEPTH_STRATEGY_HPP
 
 #include "ExpectimaxStrategy.hpp"
+#include "../thread_pool.hpp"
 
 class ExpectimaxDepthStrategy : public ExpectimaxStrategy {
     static constexpr int CACHE_DEPTH = 2;
+    static constexpr int PARALLEL_DEPTH = 3;  // the parallel search runs anything shallower than this as a single task
+
+    std::unique_ptr<ThreadPool> pool;  // only exists if the search is parallel
 
 public:
     const int depth;  // note that depth increases runtime exponentially; non-positive depth uses depth picker
-    ExpectimaxDepthStrategy(const int _depth, const heuristic_t _evaluator) :
-            ExpectimaxStrategy(_evaluator), depth(_depth) {
-        init_cache();
+    const int threads;  // searching with multiple threads only helps a single game finish faster, not the tester
+
+    ExpectimaxDepthStrategy(const int _depth, const heuristic_t _evaluator, const bool _canonical = false, const int _threads = 1,
+                            const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxStrategy(_evaluator, _canonical, cache_bytes), depth(_depth), threads(_threads) {
+        if (threads > 1) pool = std::make_unique<ThreadPool>(threads);
     }
 
-    ExpectimaxDepthStrategy(const int _depth, const int heuristic_idx) :
-            ExpectimaxDepthStrategy(_depth, heuristics::exports[heuristic_idx]) {}
+    ExpectimaxDepthStrategy(const int _depth, const int heuristic_idx, const bool _canonical = false, const int _threads = 1,
+                            const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxDepthStrategy(_depth, heuristics::exported(heuristic_idx), _canonical, _threads, cache_bytes) {}
 
     std::unique_ptr<Strategy> clone() override {
-        return std::make_unique<ExpectimaxDepthStrategy>(depth, evaluator);
+        return share_cache_with_clone(std::make_unique<ExpectimaxDepthStrategy>(depth, evaluator, canonical, threads, cache->size_bytes()));
     }
 
     const int pick_move(const board_t board) override {
+        cache->new_search();
         const int depth_to_use = depth <= 0 ? pick_depth(board) - depth : depth;
 
-        const int move = helper(board, depth_to_use, 0) & 3;
-        update_cache_pointers();
+        const int move = search(board, depth_to_use) & 3;
         return move;
     }
 
+protected:
+    // the depth is part of it, since probes take any result that's at least as deep as they need,
+    // so a player reusing deeper saved results would be measuring a mix of searches instead of its own depth
+    std::string search_identity() const override {
+        return "expectimax depth " + std::to_string(depth);
+    }
+
+    // lets a search be cut off partway through, for strategies with a time limit
+    // once the deadline passes, every search call returns right away and nothing more gets cached,
+    // so the result of a stopped search is garbage and has to be thrown out
+    using clock = std::chrono::steady_clock;
+    bool has_deadline = false;
+    clock::time_point deadline;
+    std::atomic<bool> stopped{false};
+
+    void set_deadline(const clock::time_point _deadline) {
+        has_deadline = true;
+        deadline = _deadline;
+        stopped.store(false, std::memory_order_relaxed);
+    }
+
+    void clear_deadline() {
+        has_deadline = false;
+        stopped.store(false, std::memory_order_relaxed);
+    }
+
+    bool out_of_time() {
+        if (!has_deadline) return false;
+        if (stopped.load(std::memory_order_relaxed)) return true;
+        if (clock::now() < deadline) return false;
+        stopped.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    // the search is instantiated separately for each heuristic, so that the heuristic can be inlined at the leaves
+    const eval_t search(const board_t board, const int search_depth) {
+        return heuristics::with_evaluator(evaluator, [this, board, search_depth](const auto evaluate) {
+            return pool ? parallel_helper(evaluate, board, search_depth, 0) : helper(evaluate, board, search_depth, 0);
+        });
+    }
+
 private:
-    const eval_t helper(const board_t board, const int cur_depth, const int fours) {
-        if (simulator.game_over(board)) {
-            const eval_t score = MULT * evaluator(board);
-            return (score - (score >> 2)) << 2;  // subtract score / 4 as penalty for dying, then pack
-        }
-        if (cur_depth == 0 || fours >= 4) {  // selecting 4 fours has a 0.01% chance, which is negligible
-            return (MULT * evaluator(board)) << 2;  // move doesn't matter
-        }
+    // the bottom levels of the tree have almost all of the nodes, so each of them gets its own copy of the search
+    // with the depth known at compile time, and everything above them shares one copy that takes the depth at runtime
+    // more levels than this barely helps, and every one of them is another copy for each evaluator
+    static constexpr int FIXED_DEPTHS = 2;
+    static constexpr int RUNTIME_DEPTH = -1;  // stands in for D when the depth isn't known at compile time
 
-        if (cur_depth >= CACHE_DEPTH) {
-            const cache_t::iterator it = cache.find(board);
+    template<class Evaluator>
+    const eval_t game_over_score(const Evaluator& evaluate, const board_t board) {
+        stats.count_leaf();
+        const eval_t score = MULT * evaluate(board);
+        return (score - (score >> 2)) << 2;  // subtract score / 4 as penalty for dying, then pack
+    }
+
+    // with REQUIRE_DETERMINISTIC, a cached result has to be exactly what searching the board again would give,
+    // so that the result doesn't depend on the order boards were searched in (which the parallel search doesn't fix)
+    // a search that has already seen more fours gets cut off sooner, so the number of fours is part of the key
+    bool probe(const board_t board, const int cur_depth, const int fours, eval_t& cached) {
+        int cached_depth;
+#ifdef REQUIRE_DETERMINISTIC
+        return probe_cache(board, cached, cached_depth, fours) && cached_depth == cur_depth;
+#else
+        return probe_cache(board, cached, cached_depth) && cached_depth >= cur_depth;
+#endif
+    }
+
+    void store(const board_t board, const eval_t score, const int move, const int cur_depth, const int fours) {
 #ifdef REQUIRE_DETERMINISTIC
-            if (it != cache.end() && (it->second & 0xF) == cur_depth) return it->second >> 4;
+        add_to_cache(board, score, move, cur_depth, fours);
 #else
-            if (it != cache.end() && (it->second & 0xF) >= cur_depth) return it->second >> 4;
+        add_to_cache(board, score, move, cur_depth);
 #endif
+    }
+
+    // score of a board that isn't searched any further, without the move packed in
+    // a board can only be game over if it's full, and the caller usually already knows whether it is
+    template<class Evaluator>
+    const eval_t leaf_score(const Evaluator& evaluate, const board_t board, const bool full) {
+        if (full) {
+            stats.count_game_over_check();
+            if (simulator.game_over(board)) return game_over_score(evaluate, board) >> 2;
+        }
+        stats.count_leaf();
+        return MULT * evaluate(board);
+    }
+
+    // searches cur_depth more moves deep, going to the copy for that depth if it's one of the fixed ones
+    template<int D = 1, class Evaluator>
+    const eval_t helper(const Evaluator& evaluate, const board_t board, const int cur_depth, const int fours) {
+        if constexpr (D <= FIXED_DEPTHS) {
+            if (cur_depth <= D) return search_node<D>(evaluate, board, D, fours);
+            return helper<D + 1>(evaluate, board, cur_depth, fours);
+        } else {
+            return search_node<RUNTIME_DEPTH>(evaluate, board, cur_depth, fours);
+        }
+    }
+
+    // score of a spawn, which is searched cur_depth more moves deep unless it's a leaf
+    template<int D, class Evaluator>
+    const eval_t child_score(const Evaluator& evaluate, const board_t board, const int cur_depth, const int fours, const bool full) {
+        if constexpr (D == 0) {
+            return leaf_score(evaluate, board, full);
+        } else {
+            if (fours >= 4) return leaf_score(evaluate, board, full);  // selecting 4 fours has a 0.01% chance, which is negligible
+            if constexpr (D == RUNTIME_DEPTH) return helper(evaluate, board, cur_depth, fours) >> 2;
+            else return search_node<D>(evaluate, board, D, fours) >> 2;
+        }
+    }
+
+    // a single node of the search, where D is either the depth or RUNTIME_DEPTH for the levels above the fixed ones
+    // with the depth known, the nodes right above the leaves skip the cache and deadline checks entirely
+    template<int D, class Evaluator>
+    const eval_t search_node(const Evaluator& evaluate, const board_t board, const int cur_depth, const int fours) {
+        static_assert(D > 0 || D == RUNTIME_DEPTH);
+        constexpr bool cached_level = D == RUNTIME_DEPTH || D >= CACHE_DEPTH;
+        constexpr int child_depth = D == RUNTIME_DEPTH ? RUNTIME_DEPTH : D - 1;
+        stats.count_node(cur_depth);
+
+        eval_t cached;
+        if constexpr (cached_level) {
+            if (probe(board, cur_depth, fours, cached)) return cached;
+            // nodes right above the leaves are fast enough that their parent checking the time is good enough
+            if (out_of_time()) return 0;
         }
 
+        // game over boards are never cached, so checking for them after the cache lookup is fine
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
+        if (legal == 0) return game_over_score(evaluate, board);
+
         eval_t best_score = heuristics::MIN_EVAL;
         int best_move = -1;
         for (int i = 0; i < 4; ++i) {
             eval_t expected_score = 0;
-            const board_t new_board = simulator.make_move(board, i);
-            if (board == new_board) {
+            const board_t new_board = new_boards[i];
+            if (((legal >> i) & 1) == 0) {
                 continue;
             } else {
                 const uint16_t empty_mask = to_tile_mask(new_board);
+                const int empty_ct = count_empty(empty_mask);
                 for (int j = 0; j < 16; ++j) {
                     if (((empty_mask >> j) & 1) == 0) {
-                        expected_score += 9 * (helper(new_board | (1LL << (j << 2)), cur_depth - 1, fours) >> 2);
-                        expected_score += 1 * (helper(new_board | (2LL << (j << 2)), cur_depth - 1, fours + 1) >> 2);
+                        expected_score += 9 * child_score<child_depth>(evaluate, new_board | (1LL << (j << 2)), cur_depth - 1, fours, empty_ct == 1);
+                        expected_score += 1 * child_score<child_depth>(evaluate, new_board | (2LL << (j << 2)), cur_depth - 1, fours + 1, empty_ct == 1);
                     }
                 }
-                expected_score /= count_empty(empty_mask) * 10;  // convert to actual expected score * MULT
+                expected_score /= empty_ct * 10;  // convert to actual expected score * MULT
             }
 
             if (best_score <= expected_score) {
@@ -71,10 +192,72 @@ private:
             }
         }
 
-        if (cur_depth >= CACHE_DEPTH) {
-            add_to_cache(board, best_score, best_move, cur_depth);
+        if constexpr (cached_level) {
+            if (stopped.load(std::memory_order_relaxed)) return 0;  // some of the expected scores are wrong
+            store(board, best_score, best_move, cur_depth, fours);
+        }
+
+        return (best_score << 2) | best_move;  // pack both score and move
+    }
+
+    // same search as helper, except every spawn near the top of the tree becomes a task for the pool
+    // all the threads share the cache, and the results are added up the same way as in helper once every task is done,
+    // so the integer sums (and the move) come out exactly the same as a single-threaded search
+    template<class Evaluator>
+    const eval_t parallel_helper(const Evaluator& evaluate, const board_t board, const int cur_depth, const int fours) {
+        if (fours >= 4) return leaf_score(evaluate, board, true) << 2;
+        if (cur_depth < PARALLEL_DEPTH) return helper(evaluate, board, cur_depth, fours);
+
+        stats.count_node(cur_depth);
+        eval_t cached;
+        if (probe(board, cur_depth, fours, cached)) return cached;
+        if (out_of_time()) return 0;
+
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
+        if (legal == 0) return game_over_score(evaluate, board);
+
+        eval_t results[4][16][2];
+        {
+            TaskGroup tasks(*pool);
+            for (int i = 0; i < 4; ++i) {
+                if (((legal >> i) & 1) == 0) continue;
+                const board_t new_board = new_boards[i];
+                const uint16_t empty_mask = to_tile_mask(new_board);
+                for (int j = 0; j < 16; ++j) {
+                    if (((empty_mask >> j) & 1) == 0) {
+                        tasks.run([this, &evaluate, &results, new_board, cur_depth, fours, i, j] {
+                            results[i][j][0] = parallel_helper(evaluate, new_board | (1LL << (j << 2)), cur_depth - 1, fours) >> 2;
+                        });
+                        tasks.run([this, &evaluate, &results, new_board, cur_depth, fours, i, j] {
+                            results[i][j][1] = parallel_helper(evaluate, new_board | (2LL << (j << 2)), cur_depth - 1, fours + 1) >> 2;
+                        });
+                    }
+                }
+            }
+            tasks.wait();
+        }
+        if (stopped.load(std::memory_order_relaxed)) return 0;
+
+        eval_t best_score = heuristics::MIN_EVAL;
+        int best_move = -1;
+        for (int i = 0; i < 4; ++i) {
+            if (((legal >> i) & 1) == 0) continue;
+
+            eval_t expected_score = 0;
+            const uint16_t empty_mask = to_tile_mask(new_boards[i]);
+            for (int j = 0; j < 16; ++j) {
+                if (((empty_mask >> j) & 1) == 0) expected_score += 9 * results[i][j][0] + results[i][j][1];
+            }
+            expected_score /= count_empty(empty_mask) * 10;  // convert to actual expected score * MULT
+
+            if (best_score <= expected_score) {
+                best_score = expected_score;
+                best_move = i;
+            }
         }
 
+        store(board, best_score, best_move, cur_depth, fours);
         return (best_score << 2) | best_move;  // pack both score and move
     }
 
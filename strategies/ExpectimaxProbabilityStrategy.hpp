@@ -6,49 +6,71 @@
 class ExpectimaxProbabilityStrategy : public ExpectimaxStrategy {
 public:
     const float min_probability;  // minimum probability a searched state should have
-    ExpectimaxProbabilityStrategy(const float min_prob, const heuristic_t _evaluator) :
-            ExpectimaxStrategy(_evaluator), min_probability(min_prob) {
-        init_cache();
-    }
+    ExpectimaxProbabilityStrategy(const float min_prob, const heuristic_t _evaluator, const bool _canonical = false,
+                                  const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxStrategy(_evaluator, _canonical, cache_bytes), min_probability(min_prob) {}
 
-    ExpectimaxProbabilityStrategy(const float min_prob, const int heuristic_idx) :
-            ExpectimaxProbabilityStrategy(min_prob, heuristics::exports[heuristic_idx]) {}
+    ExpectimaxProbabilityStrategy(const float min_prob, const int heuristic_idx, const bool _canonical = false,
+                                  const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxProbabilityStrategy(min_prob, heuristics::exported(heuristic_idx), _canonical, cache_bytes) {}
 
     std::unique_ptr<Strategy> clone() override {
-        return std::make_unique<ExpectimaxProbabilityStrategy>(min_probability, evaluator);
+        return share_cache_with_clone(std::make_unique<ExpectimaxProbabilityStrategy>(min_probability, evaluator, canonical, cache->size_bytes()));
     }
 
     const int pick_move(const board_t board) override {
-        const int move = helper(board, 1.0f, MAX_DEPTH) & 3;
-        update_cache_pointers();
+        cache->new_search();
+        // the search is instantiated separately for each heuristic, so that the heuristic can be inlined at the leaves
+        const int move = heuristics::with_evaluator(evaluator, [this, board](const auto evaluate) {
+            return helper(evaluate, board, 1.0f, MAX_DEPTH);
+        }) & 3;
         return move;
     }
 
+protected:
+    std::string search_identity() const override {
+        return "expectimax probability " + std::to_string(min_probability);
+    }
+
 private:
-    const eval_t helper(const board_t board, const float cur_prob, const int cur_depth) {  // depth only used for cache
-        if (simulator.game_over(board)) {
-            const eval_t score = MULT * evaluator(board);
-            return (score - (score >> 2)) << 2;  // subtract score / 4 as penalty for dying, then pack
-        }
+    template<class Evaluator>
+    const eval_t helper(const Evaluator& evaluate, const board_t board, const float cur_prob, const int cur_depth) {  // depth only used for cache
         if (cur_prob <= min_probability || cur_depth == 0) {
-            return (MULT * evaluator(board)) << 2;  // move doesn't matter
+            stats.count_leaf();
+            stats.count_game_over_check();
+            if (simulator.game_over(board)) {
+                const eval_t score = MULT * evaluate(board);
+                return (score - (score >> 2)) << 2;  // subtract score / 4 as penalty for dying, then pack
+            }
+            return (MULT * evaluate(board)) << 2;  // move doesn't matter
         }
+        stats.count_node(cur_depth);
 
         if (cur_prob > min_probability * 8) {
-            const cache_t::iterator it = cache.find(board);
+            eval_t cached;
+            int cached_depth;
 #ifdef REQUIRE_DETERMINISTIC
-            if (it != cache.end() && (it->second & 0xF) == cur_depth) return it->second >> 4;
+            if (probe_cache(board, cached, cached_depth) && cached_depth == cur_depth) return cached;
 #else
-            if (it != cache.end() && (it->second & 0xF) >= cur_depth) return it->second >> 4;
+            if (probe_cache(board, cached, cached_depth) && cached_depth >= cur_depth) return cached;
 #endif
         }
 
+        // game over boards are never cached, so checking for them after the cache lookup is fine
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
+        if (legal == 0) {
+            stats.count_leaf();
+            const eval_t score = MULT * evaluate(board);
+            return (score - (score >> 2)) << 2;  // subtract score / 4 as penalty for dying, then pack
+        }
+
         eval_t best_score = heuristics::MIN_EVAL;
         int best_move = -1;
         for (int i = 0; i < 4; ++i) {
             eval_t expected_score = 0;
-            const board_t new_board = simulator.make_move(board, i);
-            if (board == new_board) {
+            const board_t new_board = new_boards[i];
+            if (((legal >> i) & 1) == 0) {
                 continue;
             } else {
                 const uint16_t empty_mask = to_tile_mask(new_board);
@@ -57,8 +79,8 @@ private:
                 const float four_prob = cur_prob * 0.1 / empty_count;
                 for (int j = 0; j < 16; ++j) {
                     if (((empty_mask >> j) & 1) == 0) {
-                        expected_score += 9 * (helper(new_board | (1LL << (j << 2)), two_prob, cur_depth - 1) >> 2);
-                        expected_score += 1 * (helper(new_board | (2LL << (j << 2)), four_prob, cur_depth - 1) >> 2);
+                        expected_score += 9 * (helper(evaluate, new_board | (1LL << (j << 2)), two_prob, cur_depth - 1) >> 2);
+                        expected_score += 1 * (helper(evaluate, new_board | (2LL << (j << 2)), four_prob, cur_depth - 1) >> 2);
                     }
                 }
                 expected_score /= empty_count * 10;  // convert to actual expected score * MULT
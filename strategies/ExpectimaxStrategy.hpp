@@ -2,88 +2,127 @@
 #define EXPECTIMAX_STRATEGY_HPP
 
 #include "Strategy.hpp"
-#include "sparsehash/dense_hash_map"
-//using cache_t = std::unordered_map<board_t, eval_t>;
-using cache_t = google::dense_hash_map<board_t, eval_t>;  // https://github.com/sparsehash/sparsehash
+#include "../transposition_table.hpp"
 
 class ExpectimaxStrategy : public Strategy {
 protected:
     const heuristic_t evaluator;
 
-    ExpectimaxStrategy(const heuristic_t _evaluator) : evaluator(_evaluator) {}
+    // if set, the cache stores every board under the smallest of its 8 symmetries, so all of them share one entry
+    // this is only correct if the heuristic gives the same value for every symmetry of a board (see heuristics::is_symmetric),
+    // so it's ignored for any heuristic that doesn't, since the cache would give back results from the wrong symmetry
+    const bool canonical;
 
-    static constexpr int MAX_DEPTH = 10;
-    static constexpr int USUAL_CACHE = 1 << 16;
-
-    static constexpr board_t
-    INVALID_BOARD = 0x1111111111111111ULL;  // used as the empty_key for the dense_hash_map cache
-    static constexpr board_t
-    INVALID_BOARD2 = 0x2222222222222222ULL;  // used as the delete_key for the dense_hash_map cache
-
-    // according to a single benchmark that I ran:
+    // according to a single benchmark that I ran (back when the cache was a hash map):
     // cache can reach up to 700k-ish
     // but 99% of the time it's less than 130k
     // and 97% of the time it's less than 60k
-    static constexpr int MAX_CACHE = 1 << 20;  // code below assumes this is power of 2
+    static constexpr size_t DEFAULT_CACHE_BYTES = 16 << 20;  // 1M entries of 16 bytes each
 
-    cache_t cache;
+    // this is a shared_ptr so that several strategies can use one cache (see share_cache)
+    std::shared_ptr<TranspositionTable> cache;
+    bool shared_cache = false;
 
-    board_t deletion_queue[MAX_CACHE];
-    int q[4] = {0, 0, 0, 0};
-    int q_end = 0;
-    // queue is circular, with 5 pointers
-    // after each turn, the range from q_0 to q_1 gets deleted and everything shifts upward
+    // the cache never takes more than cache_bytes, and nothing is allocated until the first move
+    ExpectimaxStrategy(const heuristic_t _evaluator, const bool _canonical, const size_t cache_bytes) :
+            evaluator(_evaluator), canonical(_canonical && heuristics::is_symmetric(_evaluator)), cache(std::make_shared<TranspositionTable>(cache_bytes)) {}
+
+    static constexpr int MAX_DEPTH = 10;
 
     // speed things up with integer arithmetic
     // expected score * 10, 4 moves, 30 tile placements, multiplied by 4 to pack score and move, times 16 to pack cache
     static constexpr eval_t MULT = 9e18 / (heuristics::MAX_EVAL * 10 * 4 * 30 * 4 * 16);
     static_assert(MULT > 1);
 
-    void init_cache() {
-        cache = cache_t(USUAL_CACHE);
-        cache.set_empty_key(INVALID_BOARD);
-        cache.set_deleted_key(INVALID_BOARD2);
-        cache.min_load_factor(0.3);  // shrink quickly
-        cache.max_load_factor(0.9);  // but expand slowly
+    // the cached move is for the board that was stored, so it has to be converted back if the key was a symmetry of the board
+    bool probe_cache(const board_t board, eval_t& value, int& depth, const int variant = 0) {
+        const bool hit = canonical ? probe_canonical(board, value, depth, variant) : cache->probe(board, value, depth, variant);
+        stats.count_probe(hit);
+        return hit;
     }
 
-    void add_to_cache(const board_t board, const eval_t score, const int move, const int depth) {
-        cache[board] = (((score << 2) | move) << 4) | depth;
-
-        // relies on MAX_CACHE being a power of 2
-        deletion_queue[q_end & (MAX_CACHE - 1)] = board;
-        ++q_end;
-        if (q[0] + MAX_CACHE == q_end) {
-            cache.erase(deletion_queue[q[0]++]);
-            if (q[0] >= MAX_CACHE) {
-                q[0] -= MAX_CACHE;
-                q[1] -= MAX_CACHE;
-                q[2] -= MAX_CACHE;
-                q[3] -= MAX_CACHE;
-                q_end -= MAX_CACHE;
-            }
+    void add_to_cache(const board_t board, const eval_t score, const int move, const int depth, const int variant = 0) {
+        TranspositionTable::Replaced replaced;
+        if (!canonical) {
+            replaced = cache->store(board, (score << 2) | move, depth, variant);
+        } else {
+            int transform;
+            const board_t canonical_key = canonical_board(board, transform);
+            replaced = cache->store(canonical_key, (score << 2) | transform_move(move, transform), depth, variant);
         }
+        stats.count_store(replaced == TranspositionTable::Replaced::NOTHING, replaced == TranspositionTable::Replaced::SAME_BOARD);
     }
 
-    void update_cache_pointers() {
-        while (q[0] < q[1]) {  // delete everything in range q_0 ... q_1
-            cache.erase(deletion_queue[q[0]++]);
-            if (q[0] >= MAX_CACHE) {
-                q[0] -= MAX_CACHE;
-                q[1] -= MAX_CACHE;
-                q[2] -= MAX_CACHE;
-                q[3] -= MAX_CACHE;
-                q_end -= MAX_CACHE;
-            }
+    // gives a clone the same cache as this strategy if it's shared
+    template<class T>
+    std::unique_ptr<Strategy> share_cache_with_clone(std::unique_ptr<T> clone) {
+        if (shared_cache) clone->share_cache(*this);
+        return clone;
+    }
+
+    // everything about the search besides the heuristic that the cached results depend on
+    virtual std::string search_identity() const = 0;
+
+    // identifies the cached results for load_cache and save_cache, or is empty if they can't be saved
+    // heuristics are identified by their index in exports, so the custom ones can't be saved since they change at runtime
+    // this can't tell if an exported heuristic was changed, so saved caches need to be deleted after that
+    std::string cache_identity() const {
+        for (int i = 0; i < heuristics::FIRST_CUSTOM_EXPORT; ++i) {
+            if (evaluator != heuristics::exports[i]) continue;
+#ifdef REQUIRE_DETERMINISTIC
+            const bool deterministic = true;
+#else
+            const bool deterministic = false;
+#endif
+            return search_identity() + " heuristic=" + std::to_string(i) + " canonical=" + std::to_string(canonical) +
+                   " deterministic=" + std::to_string(deterministic) + " mult=" + std::to_string(MULT);
         }
-        q[1] = std::max(q[0], q[2]);
-        q[2] = std::max(q[0], q[3]);  // possible that stuff was deleted while searching because cache got too big
-        q[3] = q_end;
+        return "";
+    }
+
+private:
+    bool probe_canonical(const board_t board, eval_t& value, int& depth, const int variant) {
+        int transform;
+        if (!cache->probe(canonical_board(board, transform), value, depth, variant)) return false;
+        value = (value & ~3LL) | untransform_move(value & 3, transform);
+        return true;
     }
 
 public:
+    // switches this strategy over to other's cache, and makes clones of either one use it too
+    // every strategy sharing a cache has to search the same way with the same heuristic, or the results won't make sense
+    // a shared cache is never cleared (which is fine, since the results don't depend on which game a board came from),
+    // so the strategies can keep playing separate games on separate threads
+    void share_cache(ExpectimaxStrategy& other) {
+        assert(evaluator == other.evaluator && canonical == other.canonical);
+        other.cache->allocate();  // before any other thread can get to it
+        cache = other.cache;
+        shared_cache = other.shared_cache = true;
+    }
+
+    // makes clones of this strategy share its cache
+    void share_cache() {
+        share_cache(*this);
+    }
+
+    // starts the cache off with the results in a file from save_cache, without reading any more of it than gets used
+    // this has to happen before the cache is shared, and returns false if the file is missing or from a different search
+    bool load_cache(const std::string& filename) {
+        const std::string identity = cache_identity();
+        return !identity.empty() && cache->load(filename, identity);
+    }
+
+    // saves the results from the loaded file along with every result in the cache that looked at least min_depth moves
+    // ahead, since those are the ones that are worth keeping around; none of the strategies using the cache can be searching
+    bool save_cache(const std::string& filename, const int min_depth = 3) {
+        const std::string identity = cache_identity();
+        return !identity.empty() && cache->save(filename, identity, min_depth);
+    }
+
     void reset() override {
-        cache.clear();
+        if (shared_cache) return;
+        cache->clear();
+        stats.count_cache_clear();
     }
 };
 
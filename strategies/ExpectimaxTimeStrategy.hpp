@@ -0,0 +1,64 @@
+#ifndef EXPECTIMAX_TIME_STRATEGY_HPP
+#define EXPECTIMAX_TIME_STRATEGY_HPP
+
+#include "ExpectimaxDepthStrategy.hpp"
+
+// searches depth 1, then depth 2, and so on until it runs out of time, and plays the move from the deepest search that finished
+// the search in progress is stopped as soon as the time limit passes, so a move never takes (much) longer than the limit
+class ExpectimaxTimeStrategy : public ExpectimaxDepthStrategy {
+public:
+    const long long time_limit;  // in microseconds
+    int completed_depth = 0;  // depth of the last search that finished, for benchmarking
+
+    ExpectimaxTimeStrategy(const long long _time_limit, const heuristic_t _evaluator, const bool _canonical = false, const int _threads = 1,
+                           const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxDepthStrategy(MAX_DEPTH, _evaluator, _canonical, _threads, cache_bytes), time_limit(_time_limit) {}
+
+    ExpectimaxTimeStrategy(const long long _time_limit, const int heuristic_idx, const bool _canonical = false, const int _threads = 1,
+                           const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            ExpectimaxTimeStrategy(_time_limit, heuristics::exported(heuristic_idx), _canonical, _threads, cache_bytes) {}
+
+    std::unique_ptr<Strategy> clone() override {
+        return share_cache_with_clone(std::make_unique<ExpectimaxTimeStrategy>(time_limit, evaluator, canonical, threads, cache->size_bytes()));
+    }
+
+    const int pick_move(const board_t board) override {
+        const clock::time_point start_time = clock::now();
+        set_deadline(start_time + std::chrono::microseconds(time_limit));
+        cache->new_search();
+
+        // if not even depth 1 finishes, any legal move is better than nothing
+        int move = std::countr_zero(static_cast<unsigned>(simulator.legal_moves(board)));
+        completed_depth = 0;
+        clock::duration last_time = clock::duration::zero();
+        for (int cur_depth = 1; cur_depth <= depth; ++cur_depth) {
+            const clock::time_point iteration_start = clock::now();
+            const eval_t result = search(board, cur_depth);
+            if (stopped.load(std::memory_order_relaxed)) break;  // this search got cut off, so its result is garbage
+
+            move = result & 3;
+            completed_depth = cur_depth;
+
+            // don't start a search that probably can't finish, since the time spent on it would be wasted
+            // each depth costs about as many times more than the last as the last did than the one before,
+            // and the next search is never faster than this one
+            // the deeper searches still reuse any cache entries from the shallower ones and from earlier moves
+            const clock::time_point now = clock::now();
+            const clock::duration cur_time = now - iteration_start;
+            const double growth = last_time.count() > 0 ? std::max(1.0, 1.0 * cur_time.count() / last_time.count()) : 1.0;
+            if (now + std::chrono::duration_cast<clock::duration>(cur_time * growth) >= deadline) break;
+            last_time = cur_time;
+        }
+
+        clear_deadline();
+        return move;
+    }
+
+protected:
+    // searches every depth up to whatever fits in the time limit, so its results don't belong to any one depth
+    std::string search_identity() const override {
+        return "expectimax time";
+    }
+};
+
+#endif
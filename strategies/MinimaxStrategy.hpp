@@ -2,81 +2,269 @@
 #define MINIMAX_STRATEGY_HPP
 
 #include "Strategy.hpp"
+#include "../thread_pool.hpp"
+#include "../transposition_table.hpp"
 
 class MinimaxStrategy : public Strategy {
     /*
         Parameters:
             depth: depth to search, should be positive; note that search space increases exponentially with depth
                    a nonpositive depth argument d will be subtracted from the depth picker's result (increasing the depth)
+            threads: splitting up a search only helps a single game finish faster, not the tester
+            cache_bytes: the cache never takes more than this, and nothing is allocated until the first move
     */
 
+    static constexpr int CACHE_DEPTH = 2;  // shallower results are cheaper to search again than to look up
+    static constexpr int MAX_DEPTH = 15;  // the cache only has 4 bits for the depth
+    static constexpr size_t DEFAULT_CACHE_BYTES = 16 << 20;
+
+    // alpha-beta only gives the exact score if it's inside the window, so the cache also has to remember which way it's off
+    // LOWER means the real score is at least the cached one, and UPPER means it's at most the cached one
+    // cache values are packed as (score << 4) | (bound << 2) | move
+    enum Bound {
+        EXACT = 0, LOWER = 1, UPPER = 2
+    };
+
     heuristic_t evaluator;
+    TranspositionTable cache;
+    std::unique_ptr<ThreadPool> pool;  // only exists if the search is parallel
+
+    // move ordering, since alpha-beta cuts off the most when the best move is searched first
+    // killers has the last move that caused a cutoff at each depth, and history counts cutoffs for each move, weighted
+    // by how deep they were; both are only hints, so threads can update them without caring about each other
+    std::atomic<int> killers[MAX_DEPTH + 1];
+    std::atomic<long long> history[4];
 
 public:
     int depth = 0;
+    int threads = 1;
 
-    MinimaxStrategy(const int _depth, const heuristic_t _evaluator) {
+    MinimaxStrategy(const int _depth, const heuristic_t _evaluator, const int _threads = 1, const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            cache(cache_bytes) {
         depth = _depth;
         evaluator = _evaluator;
+        threads = _threads;
+        if (threads > 1) pool = std::make_unique<ThreadPool>(threads);
+        reset_ordering();
     }
 
-    MinimaxStrategy(const int _depth, const int heuristic_idx) :
-            MinimaxStrategy(_depth, heuristics::exports[heuristic_idx]) {}
+    MinimaxStrategy(const int _depth, const int heuristic_idx, const int _threads = 1, const size_t cache_bytes = DEFAULT_CACHE_BYTES) :
+            MinimaxStrategy(_depth, heuristics::exported(heuristic_idx), _threads, cache_bytes) {}
 
     std::unique_ptr<Strategy> clone() override {
-        return std::make_unique<MinimaxStrategy>(depth, evaluator);
+        return std::make_unique<MinimaxStrategy>(depth, evaluator, threads, cache.size_bytes());
     }
 
     const int pick_move(const board_t board) override {
-        const int depth_to_use = depth <= 0 ? pick_depth(board) - depth : depth;
-        const int move = helper(board, depth_to_use, heuristics::MIN_EVAL, heuristics::MAX_EVAL, 0) & 3;
+        cache.new_search();
+        const int depth_to_use = std::min(depth <= 0 ? pick_depth(board) - depth : depth, MAX_DEPTH);
+        // the search is instantiated separately for each heuristic, so that the heuristic can be inlined at the leaves
+        const int move = heuristics::with_evaluator(evaluator, [this, board, depth_to_use](const auto evaluate) {
+            return max_node<true>(evaluate, board, depth_to_use, heuristics::MIN_EVAL, heuristics::MAX_EVAL);
+        }) & 3;
         return move;
     }
 
+    void reset() override {
+        cache.clear();
+        stats.count_cache_clear();
+        reset_ordering();
+    }
+
 private:
-    const eval_t helper(const board_t board, const int cur_depth, eval_t alpha, const eval_t beta0, const int fours) {
-        if (simulator.game_over(board)) {
-            const eval_t score = evaluator(board);
-            return score - (score >> 4);  // subtract score / 16 as penalty for dying
-        }
-        if (cur_depth == 0 || fours >= 5) { // selecting 5 fours has a 0.001% chance, which is negligible
-            return evaluator(board) << 2;  // move doesn't matter
+    void reset_ordering() {
+        for (std::atomic<int>& killer: killers) killer.store(-1, std::memory_order_relaxed);
+        for (std::atomic<long long>& count: history) count.store(0, std::memory_order_relaxed);
+    }
+
+    // the search uses closed windows: the result is exact if the real score is in [alpha, beta],
+    // below alpha if the real score is below alpha, and above beta if the real score is above beta
+    // results outside the window are only bounds, but exact scores never depend on the move order or on what's in the cache,
+    // so the move picked doesn't either; ties between moves go to the higher move index, like the original search
+    // the root is the only parallel node, since it's the only one that's big enough to be worth splitting up
+    template<bool parallel, class Evaluator>
+    const eval_t max_node(const Evaluator& evaluate, const board_t board, const int cur_depth, eval_t alpha, const eval_t beta) {
+        stats.count_node(cur_depth);
+
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
+        if (legal == 0) {
+            stats.count_leaf();
+            return game_over_score(evaluate, board) << 2;
         }
 
-        eval_t best_score = heuristics::MIN_EVAL;
-        int best_move = 0;  // default best_move to 0; -1 causes issues with the packing in cases of full boards
-        for (int i = 0; i < 4; ++i) {
-            eval_t current_score = heuristics::MAX_EVAL;  // next step will minimize this across all tile placements
-            const board_t new_board = simulator.make_move(board, i);
-            if (board == new_board) {
-                continue;
-            } else {
-                const uint16_t tile_mask = to_tile_mask(new_board);
-                eval_t beta = beta0;
-                for (int j = 0; j < 16; ++j) {
-                    if (((tile_mask >> j) & 1) == 0) {
-                        current_score = std::min(current_score,
-                                                 helper(new_board | (1ULL << (j << 2)), cur_depth - 1, alpha, beta, fours) >> 2);
-                        current_score = std::min(current_score,
-                                                 helper(new_board | (2ULL << (j << 2)), cur_depth - 1, alpha, beta, (fours + 1)) >> 2);
-
-                        beta = std::min(beta, current_score);
-                        if (current_score < alpha) break;
-                    }
+        int cached_move = -1;
+        if (cur_depth >= CACHE_DEPTH) {
+            eval_t cached;
+            int cached_depth;
+            const bool hit = cache.probe(board, cached, cached_depth);
+            stats.count_probe(hit);
+            if (hit) {
+                cached_move = cached & 3;
+                const eval_t score = cached >> 4;
+                const int bound = (cached >> 2) & 3;
+#ifdef REQUIRE_DETERMINISTIC
+                const bool deep_enough = cached_depth == cur_depth;
+#else
+                const bool deep_enough = cached_depth >= cur_depth;
+#endif
+                if (deep_enough && (bound == EXACT || (bound == LOWER && score > beta) || (bound == UPPER && score < alpha))) {
+                    return (score << 2) | cached_move;
                 }
             }
-            if (best_score <= current_score) {
+        }
+
+        int order[4];
+        const int move_ct = order_moves(legal, cached_move, cur_depth, order);
+
+        const eval_t alpha0 = alpha;
+        eval_t best_score = heuristics::MIN_EVAL;
+        int best_move = order[0];
+        for (int k = 0; k < move_ct; ++k) {
+            const int i = order[k];
+            const eval_t current_score = parallel && pool != nullptr && cur_depth >= 2 ?
+                                         parallel_min_node(evaluate, new_boards[i], cur_depth, alpha, beta) :
+                                         min_node(evaluate, new_boards[i], cur_depth, alpha, beta);
+            if (best_score < current_score || (best_score == current_score && best_move < i)) {
                 best_score = current_score;
                 best_move = i;
 
                 alpha = std::max(alpha, best_score);
-                if (best_score > beta0) break;
+                if (best_score > beta) {
+                    killers[cur_depth].store(i, std::memory_order_relaxed);
+                    history[i].fetch_add(cur_depth * cur_depth, std::memory_order_relaxed);
+                    break;
+                }
             }
         }
 
+        if (cur_depth >= CACHE_DEPTH) {
+            const int bound = best_score > beta ? LOWER : (best_score < alpha0 ? UPPER : EXACT);
+            const TranspositionTable::Replaced replaced = cache.store(board, (best_score << 4) | (bound << 2) | best_move, cur_depth);
+            stats.count_store(replaced == TranspositionTable::Replaced::NOTHING, replaced == TranspositionTable::Replaced::SAME_BOARD);
+        }
         return (best_score << 2) | best_move;  // pack both score and move
     }
 
+    // minimizes over every tile placement on the board that a move made
+    template<class Evaluator>
+    const eval_t min_node(const Evaluator& evaluate, const board_t board, const int cur_depth, const eval_t alpha, const eval_t beta) {
+        eval_t current_score = heuristics::MAX_EVAL;
+        if (cur_depth == 1) {
+            // the placements are leaves, so scoring them is all the work there is
+            const uint16_t empty_mask = to_tile_mask(board);
+            const bool full = count_empty(empty_mask) == 1;
+            for (int j = 0; j < 16; ++j) {
+                if (((empty_mask >> j) & 1) == 0) {
+                    current_score = std::min(current_score, leaf_score(evaluate, board | (1ULL << (j << 2)), full));
+                    current_score = std::min(current_score, leaf_score(evaluate, board | (2ULL << (j << 2)), full));
+                    if (current_score < alpha) break;
+                }
+            }
+            return current_score;
+        }
+
+        board_t placements[32];
+        const int placement_ct = order_placements(evaluate, board, placements);
+        for (int j = 0; j < placement_ct; ++j) {
+            current_score = std::min(current_score,
+                                     max_node<false>(evaluate, placements[j], cur_depth - 1, alpha, std::min(beta, current_score)) >> 2);
+            if (current_score < alpha) break;
+        }
+        return current_score;
+    }
+
+    // young brothers wait: the most promising placement is searched first, to get a window for the rest,
+    // and then the rest are searched in parallel, each with the smallest score found by the time it starts
+    // every placement that matters still gets an exact score, so the result is the same as min_node's
+    template<class Evaluator>
+    const eval_t parallel_min_node(const Evaluator& evaluate, const board_t board, const int cur_depth, const eval_t alpha, const eval_t beta) {
+        board_t placements[32];
+        const int placement_ct = order_placements(evaluate, board, placements);
+        const eval_t first_score = max_node<false>(evaluate, placements[0], cur_depth - 1, alpha, beta) >> 2;
+        if (first_score < alpha) return first_score;
+
+        std::atomic<eval_t> current_score{first_score};
+        TaskGroup tasks(*pool);
+        for (int j = 1; j < placement_ct; ++j) {
+            tasks.run([this, &evaluate, &placements, &current_score, j, cur_depth, alpha, beta] {
+                const eval_t window = current_score.load(std::memory_order_relaxed);
+                if (window < alpha) return;  // another placement already showed this move is worse than one searched before
+
+                const eval_t score = max_node<false>(evaluate, placements[j], cur_depth - 1, alpha, std::min(beta, window)) >> 2;
+                eval_t old_score = current_score.load(std::memory_order_relaxed);
+                while (score < old_score && !current_score.compare_exchange_weak(old_score, score, std::memory_order_relaxed)) {}
+            });
+        }
+        tasks.wait();
+        return current_score.load(std::memory_order_relaxed);
+    }
+
+    // puts the cached move first, then the killer move for this depth, then the rest by their history
+    // returns the number of legal moves
+    int order_moves(const int legal, const int cached_move, const int cur_depth, int order[4]) const {
+        const int killer = killers[cur_depth].load(std::memory_order_relaxed);
+        long long priority[4];
+        int move_ct = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (((legal >> i) & 1) == 0) continue;
+            priority[i] = i == cached_move ? 2LL << 60 : (i == killer ? 1LL << 60 : history[i].load(std::memory_order_relaxed));
+            order[move_ct++] = i;
+        }
+        std::sort(order, order + move_ct, [&priority](const int a, const int b) {
+            return priority[a] > priority[b];
+        });
+        return move_ct;
+    }
+
+    // every 2 and 4 that could be placed on the board, with whichever the heuristic likes most first
+    // putting the least liked first seems like it'd find cutoffs sooner, but it was the slowest order in benchmarks,
+    // slower than not sorting at all; most liked first was about 25% faster than not sorting at d=4 and d=5
+    template<class Evaluator>
+    int order_placements(const Evaluator& evaluate, const board_t board, board_t placements[32]) {
+        eval_t scores[32];
+        int order[32];
+        int placement_ct = 0;
+        const uint16_t empty_mask = to_tile_mask(board);
+        for (int j = 0; j < 16; ++j) {
+            if (((empty_mask >> j) & 1) == 0) {
+                for (const board_t tile: {1ULL, 2ULL}) {
+                    placements[placement_ct] = board | (tile << (j << 2));
+                    scores[placement_ct] = evaluate(placements[placement_ct]);
+                    order[placement_ct] = placement_ct;
+                    ++placement_ct;
+                }
+            }
+        }
+        std::sort(order, order + placement_ct, [&scores](const int a, const int b) {
+            return scores[a] > scores[b];
+        });
+
+        board_t unordered[32];
+        std::copy(placements, placements + placement_ct, unordered);
+        for (int j = 0; j < placement_ct; ++j) placements[j] = unordered[order[j]];
+        return placement_ct;
+    }
+
+    // a placement can only end the game if it filled the last empty cell, so nothing else needs a game over check
+    template<class Evaluator>
+    eval_t leaf_score(const Evaluator& evaluate, const board_t board, const bool full) {
+        stats.count_leaf();
+        if (full) {
+            stats.count_game_over_check();
+            if (simulator.game_over(board)) return game_over_score(evaluate, board);
+        }
+        return evaluate(board);
+    }
+
+    // subtract score / 16 as penalty for dying
+    // this used to be returned without packing, so the parent unpacked it into a quarter of that, which is kept as is
+    template<class Evaluator>
+    static eval_t game_over_score(const Evaluator& evaluate, const board_t board) {
+        const eval_t score = evaluate(board);
+        return (score - (score >> 4)) >> 2;
+    }
+
     const int pick_depth(const board_t board) {
         const int tile_ct = count_set(to_tile_mask(board));
         const int score = count_distinct_tiles(board) + (tile_ct <= 6 ? 0 : (tile_ct - 6) >> 1);
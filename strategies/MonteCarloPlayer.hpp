@@ -24,16 +24,23 @@ public:
         return std::make_unique<MonteCarloPlayer>(trials);
     }
 
+    void seed(const uint64_t game_seed) override {
+        Strategy::seed(game_seed);
+        random_player.seed(derive_seed(game_seed, 2));
+    }
+
     const int pick_move(const board_t board) override {
         int best_score = 0;
         int best_move = -1;
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
         for (int i = 0; i < 4; ++i) {
-            const board_t new_board = simulator.make_move(board, i);
-            if (board == new_board) continue;
+            if (((legal >> i) & 1) == 0) continue;
+            const board_t new_board = new_boards[i];
 
             int current_score = 0;
             for (int j = 0; j < trials; ++j) {
-                current_score += run_trial(simulator.add_tile(new_board, simulator.generate_random_tile_val()));
+                current_score += run_trial(simulator.add_random_tile(new_board));
             }
             if (best_score <= current_score) {
                 best_score = current_score;
@@ -46,8 +53,7 @@ public:
 private:
     const int run_trial(board_t board) {
         while (!simulator.game_over(board)) {
-            board = simulator.add_tile(simulator.make_move(board, random_player.pick_move(board)),
-                                       simulator.generate_random_tile_val());
+            board = simulator.add_random_tile(simulator.make_move(board, random_player.pick_move(board)));
         }
         return heuristics::score_heuristic(board);
     }
@@ -6,9 +6,10 @@
 class OrderedPlayer : public Strategy {
 public:
     const int pick_move(const board_t board) override {
-        if (board != simulator.make_move(board, 0)) return 0;
-        if (board != simulator.make_move(board, 1)) return 1;
-        if (board != simulator.make_move(board, 2)) return 2;
+        const int legal = simulator.legal_moves(board);
+        if (legal & 1) return 0;
+        if (legal & 2) return 1;
+        if (legal & 4) return 2;
         return 3;
     }
 
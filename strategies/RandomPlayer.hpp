@@ -2,23 +2,27 @@
 #define RANDOM_PLAYER_HPP
 
 #include "Strategy.hpp"
-#include <random>
 
 class RandomPlayer : public Strategy {
 
-    std::mt19937 move_gen{seed_generator()};
-    std::uniform_int_distribution<> move_distrib{0, 3};
+    rng_t move_gen{next_strategy_seed()};
 
     int random_move() {
-        return move_distrib(move_gen);
+        return move_gen() >> 62;
     }
 
 public:
+    void seed(const uint64_t game_seed) override {
+        Strategy::seed(game_seed);
+        move_gen.seed(derive_seed(game_seed, 1));
+    }
+
     const int pick_move(const board_t board) override {
+        const int legal = simulator.legal_moves(board);
         int move;
         do {  // this *shouldn't* infinite loop but i guess we will see...
             move = random_move();
-        } while (board == simulator.make_move(board, move));
+        } while (((legal >> move) & 1) == 0);
         return move;
     }
 
@@ -27,36 +27,50 @@ public:
     }
 
     RandomTrialsStrategy(const int _depth, const int _trials, const int heuristic_idx) :
-            RandomTrialsStrategy(_depth, _trials, heuristics::exports[heuristic_idx]) {}
+            RandomTrialsStrategy(_depth, _trials, heuristics::exported(heuristic_idx)) {}
 
     std::unique_ptr<Strategy> clone() override {
         return std::make_unique<RandomTrialsStrategy>(depth, trials, evaluator);
     }
 
     const int pick_move(const board_t board) override {
-        return helper(board, depth) & 3;
+        // the search is instantiated separately for each heuristic, so that the heuristic can be inlined at the leaves
+        return heuristics::with_evaluator(evaluator, [this, board](const auto evaluate) {
+            return helper(evaluate, board, depth);
+        }) & 3;
     }
 
 private:
-    const eval_t helper(const board_t board, const int cur_depth) {
-        if (simulator.game_over(board)) {
-            const eval_t score = (evaluator(board) * MULT) << 2;
-            return score - (score >> 4);
-        }
+    template<class Evaluator>
+    const eval_t helper(const Evaluator& evaluate, const board_t board, const int cur_depth) {
         if (cur_depth == 0) {
-            return (evaluator(board) * MULT) << 2;  // move doesn't matter
+            stats.count_leaf();
+            stats.count_game_over_check();
+            if (simulator.game_over(board)) {
+                const eval_t score = (evaluate(board) * MULT) << 2;
+                return score - (score >> 4);
+            }
+            return (evaluate(board) * MULT) << 2;  // move doesn't matter
+        }
+        stats.count_node(cur_depth);
+
+        board_t new_boards[4];
+        const int legal = simulator.make_moves(board, new_boards);
+        if (legal == 0) {
+            stats.count_leaf();
+            const eval_t score = (evaluate(board) * MULT) << 2;
+            return score - (score >> 4);
         }
 
         eval_t best_score = 0;
         int best_move = 0;  // default best_move to 0; -1 causes issues with the packing in cases of full boards
         for (int i = 0; i < 4; ++i) {
-            const board_t new_board = simulator.make_move(board, i);
-            if (board == new_board) continue;
+            if (((legal >> i) & 1) == 0) continue;
+            const board_t new_board = new_boards[i];
 
             eval_t current_score = 0;
             for (int j = 0; j < trials; ++j) {
-                current_score += helper(simulator.add_tile(new_board, simulator.generate_random_tile_val()),
-                                        cur_depth - 1) >> 2;  // extract score
+                current_score += helper(evaluate, simulator.add_random_tile(new_board), cur_depth - 1) >> 2;  // extract score
             }
             if (best_score <= current_score) {
                 best_score = current_score;
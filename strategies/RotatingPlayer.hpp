@@ -8,9 +8,10 @@ class RotatingPlayer : public Strategy {
 
 public:
     const int pick_move(const board_t board) override {
+        const int legal = simulator.legal_moves(board);
         do {
             current_move = (current_move + 1) % 4;
-        } while (board == simulator.make_move(board, current_move));
+        } while (((legal >> current_move) & 1) == 0);
         return current_move;
     }
 
@@ -4,19 +4,20 @@
 #include "Strategy.hpp"
 
 class SpamCornerPlayer : public Strategy {
-    std::mt19937 move_gen{std::mt19937()};
-    std::uniform_int_distribution<> move_distrib{0, 3};
+    rng_t move_gen{next_strategy_seed()};
 
-    int random_move() {
-        return move_distrib(move_gen);
+public:
+    void seed(const uint64_t game_seed) override {
+        Strategy::seed(game_seed);
+        move_gen.seed(derive_seed(game_seed, 1));
     }
 
-public:
     const int pick_move(const board_t board) override {
-        const int move = random_move() & 1;
-        if (board != simulator.make_move(board, move)) return move;
-        if (board != simulator.make_move(board, move ^ 1)) return move ^ 1;
-        if (board != simulator.make_move(board, move ^ 2)) return move ^ 2;
+        const int move = move_gen() >> 63;
+        const int legal = simulator.legal_moves(board);
+        if ((legal >> move) & 1) return move;
+        if ((legal >> (move ^ 1)) & 1) return move ^ 1;
+        if ((legal >> (move ^ 2)) & 1) return move ^ 2;
         return move ^ 3;
     }
 
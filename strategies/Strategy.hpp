@@ -1,22 +1,35 @@
 #ifndef STRATEGY_HPP
 #define STRATEGY_HPP
 
-#include <random>
+#include <atomic>
+#include <memory>
 #include "../game.hpp"
+#include "../rng.hpp"
+#include "../search_stats.hpp"
 #include "../util.hpp"
 
-#ifdef REQUIRE_DETERMINISTIC
-std::mt19937 seed_generator{8};  // this will generate each strategy's seeds
-#else
-std::mt19937 seed_generator{static_cast<unsigned int>(get_current_time_ms())};  // this will generate each strategy's seeds
-#endif
+std::atomic<uint64_t> strategies_created{0};
+
+// seed for a newly created strategy, which is safe to call from any thread
+// the tester reseeds strategies before every game, so this only matters for strategies that are used elsewhere
+// streams are counted down from the top so that they don't overlap with the game streams
+uint64_t next_strategy_seed() {
+    return derive_seed(run_seed, ~strategies_created++);
+}
 
 class Strategy {
 public:
-    GameSimulator simulator{static_cast<long long>(seed_generator())};
+    GameSimulator simulator{next_strategy_seed()};
+    SearchStats stats;  // stays empty unless SEARCH_STATS is defined; see search_stats.hpp
 
     virtual ~Strategy() = default;
 
+    // reseeds everything random in the strategy (including its simulator), so that a game only depends on its seed
+    // strategies with their own generators should override this and derive a separate stream for each one
+    virtual void seed(const uint64_t game_seed) {
+        simulator.seed(game_seed);
+    }
+
     virtual std::unique_ptr<Strategy> clone() = 0;
 
     virtual const int pick_move(const board_t board) = 0;
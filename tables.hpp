@@ -0,0 +1,19 @@
+#ifndef TABLES_HPP
+#define TABLES_HPP
+
+// the 2^16-entry lookup tables can be built either by the compiler or once when the program starts
+// building them at startup only takes a few milliseconds, and it keeps compiles fast and the binaries
+// (especially players.wasm) small, since the tables don't have to be evaluated by the compiler and embedded
+// define CONSTEXPR_TABLES to build them at compile time instead, which needs a raised constexpr limit:
+// -fconstexpr-steps=0x600000 for clang or -fconstexpr-ops-limit=4000000000 for gcc
+#ifdef CONSTEXPR_TABLES
+#define LOOKUP_TABLE constexpr
+#define TABLE_GENERATOR consteval
+#else
+// inline variables in the same header are initialized in the order they're defined, so tables can be built from earlier tables
+#define LOOKUP_TABLE inline const
+// the generators can't be constexpr here, or the compiler would be required to evaluate them anyway
+#define TABLE_GENERATOR
+#endif
+
+#endif
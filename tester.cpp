@@ -1,9 +1,24 @@
+// uncomment to print search statistics for each player (which slows down the searches a bit); see search_stats.hpp
+//#define SEARCH_STATS
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "batch_game.hpp"
 #include "game.hpp"
+#include "game_log.hpp"
+#include "game_stats.hpp"
 #include "heuristics.hpp"
+#include "record.hpp"
 #include "strategies/Strategy.hpp"
 #include "strategies/ExpectimaxDepthStrategy.hpp"
 #include "strategies/ExpectimaxProbabilityStrategy.hpp"
@@ -30,21 +45,45 @@ constexpr int TRIALS[MAX_DEPTH + 1] = {0, 10, 10, 10, 9, 6};
 //constexpr int MAX_DEPTH = 4;
 //constexpr int TRIALS[MAX_DEPTH + 1] = {0, 5, 5, 4, 3};
 
-constexpr int THREADS = 4;
+// uncomment to save a packed record of every game to records/<player name>-<thread>.rec (needs the records/ directory)
+//#define SAVE_RECORDS
 
-std::atomic<int> results[MAX_TILE + 1];  // counts how many games reached this tile (or higher)
-int moves[GAMES[4]];  // each index is only modified by one thread so atomic isn't necessary
-int scores[GAMES[4]];
-
-long long calculate_total(const int arr[], const int n) {
-    return std::accumulate(arr, arr + n, 0LL);
+// one thread per core, unless the TESTER_THREADS environment variable asks for a different number
+int pick_thread_count() {
+    const char* threads = std::getenv("TESTER_THREADS");
+    if (threads != nullptr && std::atoi(threads) > 0) return std::atoi(threads);
+    return std::max(1U, std::thread::hardware_concurrency());
 }
 
-float calculate_median(const int arr[], const int n) {  // if n is even, returns mean of two middle elements
-    std::vector<int> tmp(arr, arr + n);
-    sort(tmp.begin(), tmp.end());
-    return (n & 1) ? tmp[n / 2] : (tmp[(n - 1) / 2] + tmp[n / 2]) / 2.0;
-}
+const int THREADS = pick_thread_count();
+constexpr int BATCH_LANES = 32;  // games played in lockstep by each thread for the blind players
+constexpr int BATCH_GAMES = BATCH_LANES * 32;  // games that a thread takes at a time for the blind players
+
+// all of an expectimax depth player's threads share one cache, which also keeps results from earlier games around,
+// since the early and middle game positions come up again and again in games with the same strategy
+// the shared cache gets as much memory as the threads would have had between them
+// with REQUIRE_DETERMINISTIC the cache only gives exact results, so sharing doesn't change the results
+constexpr bool SHARE_CACHE = true;
+const size_t CACHE_BYTES = SHARE_CACHE ? THREADS * (16ULL << 20) : 16 << 20;
+
+// uncomment to start each expectimax depth player off with the results saved in caches/<player name>.ttc by earlier runs,
+// and to save the new results there afterwards (needs the caches/ directory)
+// each depth gets its own file, since a probe takes any result that's at least as deep as it needs, so sharing a cache
+// between depths would mix deeper searches into the shallower players' results
+//#define SAVE_CACHES
+
+// with EARLY_STOP, GAMES[speed] is only the most games a player gets: its games stop as soon as the 95% confidence intervals
+// on the 2048, 4096 and 8192 rates are within RATE_HALF_WIDTH of the rate, and the interval on the mean score is within
+// SCORE_HALF_WIDTH of the mean (as a fraction of it), or once it's used up its wall or computation time budget
+// games are handed out in order, so the games played are always the first however many, but how many depends on timing
+constexpr bool EARLY_STOP = false;
+constexpr double CONFIDENCE_Z = 1.96;
+constexpr double RATE_HALF_WIDTH = 0.005;
+constexpr double SCORE_HALF_WIDTH = 0.005;
+constexpr int MIN_GAMES = 100;  // the normal approximation isn't worth much before this
+constexpr double WALL_TIME_BUDGET = 3600;  // in seconds
+constexpr double COMPUTATION_TIME_BUDGET = 3600 * 64;  // in seconds, summed over every thread
+constexpr int STOP_TILES[3] = {11, 12, 13};  // 2048, 4096 and 8192
 
 void write_headings(std::ofstream& fout) {
     assert(fout.is_open());  // might need to create the /results directory if this doesn't work
@@ -53,84 +92,533 @@ void write_headings(std::ofstream& fout) {
         fout << ',' << (1 << i);
     }
     fout << ",Total Score,Median Score,Total Moves,Median Moves";
+    fout << ",Score P10,Score P90,Score P99,Moves P10,Moves P90,Moves P99,Move Time P50,Move Time P90,Move Time P99";
+    fout << ",Stop Reason,2048 Rate Half Width,4096 Rate Half Width,8192 Rate Half Width,Mean Score Half Width";
     fout << std::endl;
 }
 
-void save_results(std::ofstream& fout, const std::string& player_name, const int games, const float time_taken,
-                  const float computation_time) {
-    assert(fout.is_open());
-    fout << player_name << ',' << games << ',' << time_taken << ',' << computation_time;
-    for (int i = MIN_TILE; i <= MAX_TILE; ++i) {
-        fout << ',' << results[i];
+// a results CSV, along with the log of every game behind it, which lets an interrupted run pick up where it left off
+// every player that's already in results/<name>.games gets its logged games back instead of playing them again,
+// so running the tester again after an interruption rebuilds the CSVs and then carries on with the games that are missing
+// delete the .games files to start over
+struct ResultsFile {
+    std::ofstream csv;
+    GameLog log;
+
+    ResultsFile(const std::string& name) : csv("results/" + name + ".csv"), log("results/" + name + ".games") {
+        write_headings(csv);
     }
-    fout << ',' << calculate_total(scores, games) << ',' << calculate_median(scores, games) << ',' << calculate_total(moves, games) << ',' << calculate_median(moves, games);
-    fout << std::endl;
+
+    void close() {
+        csv.close();
+        log.close();
+    }
+};
+
+std::string record_filename(const std::string& player_name, const int thread) {
+    return "records/" + player_name + "-" + std::to_string(thread) + ".rec";
 }
 
-std::future<long long> futures[THREADS];
-std::atomic<int> games_remaining;
+// what a thread has seen of a comparison between two players (see compare_players)
+// differences are always the first player's result minus the second's
+struct PairedStats {
+    RunningStats scores[2];
+    RunningStats score_differences;
+    RunningStats reached_differences[3];  // the differences in whether each game reached each of STOP_TILES
+
+    void add_pair(const int max_tiles[2], const int game_scores[2]) {
+        for (int i = 0; i < 2; ++i) scores[i].add(game_scores[i]);
+        score_differences.add(game_scores[0] - game_scores[1]);
+        for (int i = 0; i < 3; ++i) reached_differences[i].add((max_tiles[0] >= STOP_TILES[i]) - (max_tiles[1] >= STOP_TILES[i]));
+    }
 
-long long test_player_thread(const std::unique_ptr<Strategy> player) {  // this function should own the player pointer
-    const long long start_time = get_current_time_ms();
-    int game_idx = --games_remaining;
-    while (game_idx >= 0) {
-        std::string record = "";
-        const board_t board = player->simulator.play(*player, record);
-        player->reset();
-        const int max_tile = get_max_tile(board);
-        ++results[max_tile];  // suffix sum type thing
+    PairedStats& operator+=(const PairedStats& other) {
+        for (int i = 0; i < 2; ++i) scores[i] += other.scores[i];
+        score_differences += other.score_differences;
+        for (int i = 0; i < 3; ++i) reached_differences[i] += other.reached_differences[i];
+        return *this;
+    }
+};
+
+// everything one thread has for a player's games, so that threads don't share anything until the results are reported
+// aligned to a cache line so that threads don't slow each other down by writing right next to each other
+struct alignas(64) Shard {
+    int results[MAX_TILE + 1] = {};  // counts how many games ended with this as the largest tile
+    StreamingStats scores;
+    StreamingStats moves;
+    StreamingStats move_times;  // each game's average time per move in nanoseconds, only for the search players
+    long long logged_time_ns = 0;  // time spent on the games that came from the log, in an earlier run
+    std::unique_ptr<Strategy> player;  // cloned when the thread gets its first game, so it only exists if the thread played
+#ifdef SAVE_RECORDS
+    std::unique_ptr<MappedRecordWriter> record;
+#endif
+
+    // only for comparisons
+    std::unique_ptr<Strategy> opponent;
+    PairedStats paired;
+};
+
+// what a task's games did, which is all that early stopping needs to know
+// comparisons only count games, so they only stop early once they've used up a budget
+struct Progress {
+    int games = 0;
+    int reached[3] = {};  // games that reached each of STOP_TILES
+    RunningStats scores;
+
+    void add_game(const int max_tile, const int score) {
+        ++games;
+        for (int i = 0; i < 3; ++i) reached[i] += max_tile >= STOP_TILES[i];
+        scores.add(score);
+    }
 
-        const int fours = count_fours(record);
-        moves[game_idx] = count_moves_made(board, fours);
-        scores[game_idx] = actual_score(board, fours);
+    Progress& operator+=(const Progress& other) {
+        games += other.games;
+        for (int i = 0; i < 3; ++i) reached[i] += other.reached[i];
+        scores += other.scores;
+        return *this;
+    }
 
-        game_idx = --games_remaining;  // games_remaining will end up negative, but that's fine
+    // half width of the Wilson score interval, which holds up better than the normal one for rates near 0 or 1
+    double rate_half_width(const int i) const {
+        if (games == 0) return 1;
+        const double rate = 1.0 * reached[i] / games;
+        const double z2 = CONFIDENCE_Z * CONFIDENCE_Z;
+        return CONFIDENCE_Z * std::sqrt(rate * (1 - rate) / games + z2 / (4.0 * games * games)) / (1 + z2 / games);
     }
-    const long long end_time = get_current_time_ms();
-    return end_time - start_time;
-}
 
-void test_player(std::ofstream& fout, const std::string& player_name, std::unique_ptr<Strategy> player, const int games) {
-    std::cout << "\n\nTesting " << player_name << " player..." << std::endl;
-    std::fill(results, results + MAX_TILE + 1, 0);
+    // as a fraction of the mean
+    double score_half_width() const {
+        if (scores.count() < 2 || scores.mean() == 0) return 1;
+        return scores.mean_half_width(CONFIDENCE_Z) / scores.mean();
+    }
+
+    bool narrow_enough() const {
+        if (games < MIN_GAMES) return false;
+        for (int i = 0; i < 3; ++i) {
+            if (rate_half_width(i) > RATE_HALF_WIDTH) return false;
+        }
+        return score_half_width() <= SCORE_HALF_WIDTH;
+    }
+};
+
+enum class StopReason {
+    GAMES, INTERVAL, WALL_TIME, COMPUTATION_TIME
+};
+const std::string STOP_REASON_NAMES[4] = {"games", "interval", "wall time", "computation time"};
+
+// one player's games, which the worker threads take from one at a time until there are none left
+// the results only get reported once every game is done, so fout has to stay open until then (see finish_tests)
+struct TestRun {
+    using task_t = std::function<Progress(TestRun&, Shard&, int, int)>;
+    using report_t = void (*)(const TestRun&);
+
+    const std::string player_name;
+    std::ofstream& fout;
+    const int games;  // the most games that get played; fewer get played if they stop early
+    const int tasks;  // a single game each for the search players, or a batch of games for the blind players
+    const task_t play_task;  // called with the run, the thread's shard, the thread's index, and the task's index
+    const report_t report;  // called once every task is done
+
+    const std::unique_ptr<Strategy> player;  // every thread plays with its own clone of this
+    const std::unique_ptr<Strategy> opponent;  // the player that player is compared against, if this is a comparison
+    uint64_t seed = run_seed;  // every game's seed is derived from this and the game's index
+
+    GameLog* log = nullptr;  // only the search players log their games, since the blind players are done in seconds anyway
+    uint32_t log_config = 0;
+    std::mutex clone_lock;
+
+    std::vector<Shard> shards;
+
+    long long start_time = 0;
+    long long end_time = 0;
+
+    // everything below is guarded by lock, which is only taken twice per task, so it doesn't get contended
+    std::mutex lock;
+    std::condition_variable done_signal;
+    int next_task = 0;
+    int task_limit;  // lowered to next_task when the games stop early
+    int tasks_done = 0;
+    long long computation_time_ns = 0;
+    Progress progress;
+    StopReason stop_reason = StopReason::GAMES;
+    bool done = false;
+
+    TestRun(const std::string& _player_name, std::ofstream& _fout, const int _games, const int _tasks, const task_t _play_task,
+            const report_t _report, std::unique_ptr<Strategy> _player = nullptr, std::unique_ptr<Strategy> _opponent = nullptr) :
+            player_name(_player_name), fout(_fout), games(_games), tasks(_tasks), play_task(_play_task), report(_report),
+            player(std::move(_player)), opponent(std::move(_opponent)), shards(THREADS), task_limit(_tasks) {}
+
+    // returns false once there's nothing left to hand out, although some tasks might still be running
+    bool take_task(int& task) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (next_task >= task_limit) return false;
+        task = next_task++;
+        return true;
+    }
+
+    void complete_task(const Progress& task_progress, const long long task_time_ns) {
+        std::lock_guard<std::mutex> guard(lock);
+        ++tasks_done;
+        progress += task_progress;
+        computation_time_ns += task_time_ns;
 
-    games_remaining.store(games);
+        if (EARLY_STOP && task_limit == tasks) {
+            if (progress.narrow_enough()) stop_early(StopReason::INTERVAL);
+            else if (get_current_time_ms() - start_time >= WALL_TIME_BUDGET * 1e3) stop_early(StopReason::WALL_TIME);
+            else if (computation_time_ns >= COMPUTATION_TIME_BUDGET * 1e9) stop_early(StopReason::COMPUTATION_TIME);
+        }
 
-    const long long start_time = get_current_time_ms();
-    for (int i = 1; i < THREADS; i++) {
-        // give the Strategy pointer ownership to test_player_thread
-        // move the player pointer last so that it can be cloned first
-        futures[i] = std::async(test_player_thread, player->clone());
+        if (tasks_done == task_limit) {
+            end_time = get_current_time_ms();
+            done = true;
+            done_signal.notify_all();
+        }
     }
-    futures[0] = std::async(test_player_thread, std::move(player));
 
-    long long computation_time_ms = 0;
-    for (int i = 0; i < THREADS; i++) {
-        computation_time_ms += futures[i].get();
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        done_signal.wait(guard, [this] { return done; });
     }
-    const long long end_time = get_current_time_ms();
 
-    const float computation_time = computation_time_ms / 1000.0;
-    const float time_taken = (end_time - start_time) / 1000.0;
+private:
+    // the tasks that are already running still finish, so that the games played are always the first few
+    void stop_early(const StopReason reason) {
+        stop_reason = reason;
+        task_limit = next_task;
+    }
+};
+
+// worker threads that stay around for the whole run, instead of new threads for every player
+// players are queued in order, and each worker takes games from the oldest player that still has games to hand out,
+// so workers move on to the next player as soon as they run out of games, instead of waiting for the slowest game to finish
+class TestPool {
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<TestRun>> queue;
+    bool stopping = false;
+
+    void work(const int slot) {
+        while (true) {
+            std::shared_ptr<TestRun> run;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return !queue.empty() || stopping; });
+                if (queue.empty()) return;
+                run = queue.front();
+            }
+
+            int task;
+            if (!run->take_task(task)) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (!queue.empty() && queue.front() == run) queue.pop_front();
+                continue;
+            }
+
+            const auto start_time = std::chrono::steady_clock::now();
+            const Progress progress = run->play_task(*run, run->shards[slot], slot, task);
+            run->complete_task(progress, (std::chrono::steady_clock::now() - start_time) / std::chrono::nanoseconds(1));
+        }
+    }
+
+public:
+    TestPool(const int threads) {
+        for (int i = 0; i < threads; ++i) workers.emplace_back(&TestPool::work, this, i);
+    }
+
+    // workers finish everything that's queued before they stop
+    ~TestPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker: workers) worker.join();
+    }
+
+    void submit(const std::shared_ptr<TestRun>& run) {
+        run->start_time = get_current_time_ms();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queue.push_back(run);
+        }
+        wake.notify_all();
+    }
+};
+
+TestPool test_pool(THREADS);
+
+// move times are in microseconds
+void save_results(const TestRun& run, const int results[], const float time_taken, const float computation_time,
+                  const StreamingStats& scores, const StreamingStats& moves, const StreamingStats& move_times) {
+    assert(run.fout.is_open());
+    run.fout << run.player_name << ',' << run.progress.games << ',' << time_taken << ',' << computation_time;
+    for (int i = MIN_TILE; i <= MAX_TILE; ++i) {
+        run.fout << ',' << results[i];
+    }
+    run.fout << ',' << scores.total() << ',' << scores.median() << ',' << moves.total() << ',' << moves.median();
+    for (const StreamingStats* stats: {&scores, &moves}) {
+        run.fout << ',' << stats->quantile(0.1) << ',' << stats->quantile(0.9) << ',' << stats->quantile(0.99);
+    }
+    run.fout << ',' << move_times.quantile(0.5) / 1e3 << ',' << move_times.quantile(0.9) / 1e3 << ',' << move_times.quantile(0.99) / 1e3;
+    run.fout << ',' << STOP_REASON_NAMES[static_cast<int>(run.stop_reason)];
+    for (int i = 0; i < 3; ++i) run.fout << ',' << run.progress.rate_half_width(i);
+    run.fout << ',' << run.progress.score_half_width();
+    run.fout << std::endl;
+}
+
+void print_distribution(const std::string& name, const StreamingStats& stats, const double scale = 1) {
+    std::cout << name << ": mean " << stats.mean() / scale << " (sd " << stats.stddev() / scale << "), p10 " << stats.quantile(0.1) / scale
+              << ", p50 " << stats.quantile(0.5) / scale << ", p90 " << stats.quantile(0.9) / scale << ", p99 " << stats.quantile(0.99) / scale
+              << ", max " << stats.max() / scale << '\n';
+}
+
+// merges every thread's shard, so this can only be called once all of the run's games are done
+void report_results(const TestRun& run) {
+    int results[MAX_TILE + 1] = {};  // counts how many games reached this tile (or higher)
+    StreamingStats scores, moves, move_times;
+    SearchStats search_stats;
+    long long logged_time_ns = 0;
+    for (const Shard& shard: run.shards) {
+        for (int i = 0; i <= MAX_TILE; ++i) results[i] += shard.results[i];
+        scores += shard.scores;
+        moves += shard.moves;
+        move_times += shard.move_times;
+        if (shard.player != nullptr) search_stats += shard.player->stats;
+        logged_time_ns += shard.logged_time_ns;
+    }
+
+    // the logged games' time counts towards the computation time, but the time taken is only how long this run took
+    const int games = run.progress.games;
+    const float computation_time = (run.computation_time_ns + logged_time_ns) / 1e9;
+    const float time_taken = (run.end_time - run.start_time) / 1000.0;
+    std::cout << "\n\nTested " << run.player_name << " player\n";
     std::cout << "Playing " << games << " games took " << time_taken << " seconds (" << time_taken / games << " seconds per game, computation time " << computation_time << ")\n";
+    if (run.stop_reason != StopReason::GAMES) {
+        std::cout << "Stopped early (" << STOP_REASON_NAMES[static_cast<int>(run.stop_reason)] << "): 2048/4096/8192 rates within +-"
+                  << run.progress.rate_half_width(0) << '/' << run.progress.rate_half_width(1) << '/' << run.progress.rate_half_width(2)
+                  << ", mean score within +-" << 100 * run.progress.score_half_width() << "%\n";
+    }
 
-    for (int i = MAX_TILE - 1; i >= 0; --i) results[i] += results[i + 1];
+    for (int i = MAX_TILE - 1; i >= 0; --i) results[i] += results[i + 1];  // suffix sum type thing
     for (int i = MIN_TILE; i <= MAX_TILE; ++i) {
         std::cout << i << ' ' << results[i] << " (" << 100.0 * results[i] / games << ')' << std::endl;
     }
-    save_results(fout, player_name, games, time_taken, computation_time);
+    print_distribution("Score", scores);
+    print_distribution("Moves", moves);
+    if (move_times.count() > 0) print_distribution("Time per move (us)", move_times, 1e3);
+    search_stats.print(std::cout);
+    save_results(run, results, time_taken, computation_time, scores, moves, move_times);
+}
+
+// the last player that was submitted, which is only reported once the next player has been submitted
+// that way the next player's games can start while the last few games of this one are still going
+std::shared_ptr<TestRun> unreported_run;
+
+// waits for every submitted player's games and reports them; call this before closing a player's fout
+void finish_tests() {
+    if (unreported_run == nullptr) return;
+    unreported_run->wait();
+    unreported_run->report(*unreported_run);
+    unreported_run.reset();
+}
+
+void submit_run(const std::shared_ptr<TestRun>& run) {
+    test_pool.submit(run);
+    finish_tests();
+    unreported_run = run;
+}
+
+void add_game(Shard& shard, Progress& progress, const int max_tile, const int score, const int moves, const long long time_taken_ns) {
+    ++shard.results[max_tile];
+    shard.scores.add(score);
+    shard.moves.add(moves);
+    if (moves > 0) shard.move_times.add(time_taken_ns / moves);
+    progress.add_game(max_tile, score);
+}
+
+Progress play_game(TestRun& run, Shard& shard, [[maybe_unused]] const int thread, const int game_idx) {
+    Progress progress;
+    if (run.log != nullptr) {
+        if (const GameLog::GameEntry* logged = run.log->find_game(run.log_config, game_idx)) {
+            add_game(shard, progress, logged->max_tile, logged->score, logged->moves, logged->time_ns);
+            shard.logged_time_ns += logged->time_ns;
+            return progress;
+        }
+    }
+
+    if (shard.player == nullptr) {
+        std::lock_guard<std::mutex> guard(run.clone_lock);
+        shard.player = run.player->clone();
+#ifdef SAVE_RECORDS
+        shard.record = std::make_unique<MappedRecordWriter>(record_filename(run.player_name, thread));
+#endif
+    }
+
+#ifdef SAVE_RECORDS
+    MappedRecordWriter& record = *shard.record;
+    record.start_game();
+#else
+    GameCounter record;
+#endif
+    Strategy& player = *shard.player;
+    const uint64_t game_seed = derive_seed(run.seed, game_idx);  // each game's result only depends on its index
+    player.seed(game_seed);
+    const long long nodes_before = player.stats.total_nodes();
+    const auto start_time = std::chrono::steady_clock::now();
+    const board_t board = player.simulator.play(player, record);
+    const long long time_taken_ns = (std::chrono::steady_clock::now() - start_time) / std::chrono::nanoseconds(1);
+    player.reset();
+    const int max_tile = get_max_tile(board);
+    add_game(shard, progress, max_tile, record.score(board), record.moves, time_taken_ns);
+
+    if (run.log != nullptr) {
+        GameLog::GameEntry entry{};
+        entry.kind = GameLog::GAME;
+        entry.config = run.log_config;
+        entry.seed = game_seed;
+        entry.game = game_idx;
+        entry.max_tile = max_tile;
+        entry.score = record.score(board);
+        entry.moves = record.moves;
+        entry.time_ns = time_taken_ns;
+        entry.nodes = player.stats.total_nodes() - nodes_before;
+        run.log->add_game(entry);
+    }
+    return progress;
+}
+
+// the games are played by clones of the player, so the player itself is only kept around to clone from
+void test_player(ResultsFile& results, const std::string& player_name, std::unique_ptr<Strategy> player, const int games) {
+    std::cout << "\n\nTesting " << player_name << " player..." << std::endl;
+    const auto run = std::make_shared<TestRun>(player_name, results.csv, games, games, play_game, report_results, std::move(player));
+    run->log = &results.log;
+    run->log_config = results.log.start_config(player_name, games, run->seed);
+    submit_run(run);
 }
 
 void test_single_player(const std::string& player_name, std::unique_ptr<Strategy> player, const int games) {
+    ResultsFile results(player_name);  // put results into a CSV for later collation
+    test_player(results, player_name, std::move(player), games);  // give ownership of Strategy pointer
+    finish_tests();
+    results.close();
+}
+
+// blind players only need to know which moves are legal, so their games can be played in lockstep batches
+// each task is BATCH_GAMES games, since every blind game costs about the same
+// the games are seeded like play_game's, so a batch policy plays the same games as its player would with the same run seed
+template<template<int> class Policy>
+Progress play_batch(TestRun& run, Shard& shard, const int, const int task) {
+    const int first_game = task * BATCH_GAMES;
+    const auto simulator = std::make_unique<BatchGameSimulator<BATCH_LANES>>(run.seed, first_game);
+    const auto policy = std::make_unique<Policy<BATCH_LANES>>();  // a generator per lane, which is big with USE_MT19937
+    Progress progress;
+    simulator->play(*policy, std::min(BATCH_GAMES, run.games - first_game), [&shard, &progress](const int, const board_t board, const int fours) {
+        const int max_tile = get_max_tile(board);
+        ++shard.results[max_tile];
+        shard.scores.add(actual_score(board, fours));
+        shard.moves.add(count_moves_made(board, fours));
+        progress.add_game(max_tile, actual_score(board, fours));
+    });
+    return progress;
+}
+
+template<template<int> class Policy>
+void test_batch_player(const std::string& player_name, const int games) {
+    std::cout << "\n\nTesting " << player_name << " player..." << std::endl;
     std::ofstream fout("results/" + player_name + ".csv");  // put results into a CSV for later collation
     write_headings(fout);
-    test_player(fout, player_name, std::move(player), games);  // give ownership of Strategy pointer
+    submit_run(std::make_shared<TestRun>(player_name, fout, games, (games + BATCH_GAMES - 1) / BATCH_GAMES, play_batch<Policy>, report_results));
+    finish_tests();
+    fout.close();
+}
+
+// both players play every game index, and since a game's tiles only depend on its seed (see GameSimulator::spawn_rng),
+// they both draw the same random numbers for their tiles, and get the same tiles for as long as their boards are the same
+// this is common random numbers: most of the luck of the tiles cancels out of the differences, so a difference between
+// two similar players shows up in far fewer games than it would by comparing two separate runs
+Progress play_pair(TestRun& run, Shard& shard, const int, const int game_idx) {
+    if (shard.player == nullptr) {
+        std::lock_guard<std::mutex> guard(run.clone_lock);
+        shard.player = run.player->clone();
+        shard.opponent = run.opponent->clone();
+    }
+
+    int max_tiles[2], scores[2];
+    Strategy* players[2] = {shard.player.get(), shard.opponent.get()};
+    for (int i = 0; i < 2; ++i) {
+        Strategy& player = *players[i];
+        GameCounter record;
+        player.seed(derive_seed(run.seed, game_idx));
+        const board_t board = player.simulator.play(player, record);
+        player.reset();
+        max_tiles[i] = get_max_tile(board);
+        scores[i] = record.score(board);
+    }
+    shard.paired.add_pair(max_tiles, scores);
+
+    Progress progress;
+    progress.games = 1;
+    return progress;
+}
+
+void report_comparison(const TestRun& run) {
+    PairedStats paired;
+    for (const Shard& shard: run.shards) paired += shard.paired;
+
+    const int games = run.progress.games;
+    const float time_taken = (run.end_time - run.start_time) / 1000.0;
+    std::cout << "\n\nCompared " << run.player_name << '\n';
+    std::cout << "Playing " << games << " pairs of games took " << time_taken << " seconds (computation time " << run.computation_time_ns / 1e9 << ")\n";
+    if (run.stop_reason != StopReason::GAMES) std::cout << "Stopped early (" << STOP_REASON_NAMES[static_cast<int>(run.stop_reason)] << ")\n";
+
+    std::cout << "Mean score: " << paired.scores[0].mean() << " vs " << paired.scores[1].mean() << ", difference " << paired.score_differences.mean()
+              << " +- " << paired.score_differences.mean_half_width(CONFIDENCE_Z) << '\n';
+    for (int i = 0; i < 3; ++i) {
+        std::cout << (1 << STOP_TILES[i]) << " rate difference: " << paired.reached_differences[i].mean()
+                  << " +- " << paired.reached_differences[i].mean_half_width(CONFIDENCE_Z) << '\n';
+    }
+    // how many times more games two separate runs would have needed for an interval this narrow
+    // if every pair of games had the same score (like a player compared with itself) there's nothing to divide by,
+    // so the CSV gets an empty field instead of inf or nan
+    const double separate_variance = paired.scores[0].variance() + paired.scores[1].variance();
+    const double difference_variance = paired.score_differences.variance();
+    if (difference_variance > 0) {
+        std::cout << "Pairing reduced the score difference's variance by a factor of " << separate_variance / difference_variance << std::endl;
+    } else {
+        std::cout << "Every pair of games had the same score, so there's no variance reduction to report" << std::endl;
+    }
+
+    assert(run.fout.is_open());
+    run.fout << run.player_name << ',' << games << ',' << time_taken << ',' << run.computation_time_ns / 1e9;
+    run.fout << ',' << paired.scores[0].mean() << ',' << paired.scores[1].mean();
+    run.fout << ',' << paired.score_differences.mean() << ',' << paired.score_differences.mean_half_width(CONFIDENCE_Z);
+    for (int i = 0; i < 3; ++i) {
+        run.fout << ',' << paired.reached_differences[i].mean() << ',' << paired.reached_differences[i].mean_half_width(CONFIDENCE_Z);
+    }
+    run.fout << ',';
+    if (difference_variance > 0) run.fout << separate_variance / difference_variance;
+    run.fout << ',' << STOP_REASON_NAMES[static_cast<int>(run.stop_reason)] << std::endl;
+}
+
+// plays both players on the same games, and saves the differences between them to results/<name_a>-vs-<name_b>.csv
+void compare_players(const std::string& name_a, std::unique_ptr<Strategy> player_a, const std::string& name_b, std::unique_ptr<Strategy> player_b,
+                     const int games) {
+    const std::string name = name_a + "-vs-" + name_b;
+    std::cout << "\n\nComparing " << name << "..." << std::endl;
+    std::ofstream fout("results/" + name + ".csv");
+    assert(fout.is_open());  // might need to create the /results directory if this doesn't work
+    fout << "Comparison,Games,Time Taken,Computation Time,Mean Score A,Mean Score B,Score Difference,Score Difference Half Width";
+    for (const int tile: STOP_TILES) fout << ',' << (1 << tile) << " Rate Difference," << (1 << tile) << " Rate Difference Half Width";
+    fout << ",Variance Reduction,Stop Reason" << std::endl;
+
+    submit_run(std::make_shared<TestRun>(name, fout, games, games, play_pair, report_comparison, std::move(player_a), std::move(player_b)));
+    finish_tests();
     fout.close();
 }
 
 void test_heuristic(const std::string& name, heuristic_t heuristic) {
-    std::ofstream fout("results/" + name + "-rnd_t.csv");  // put results into a CSV for later collation
-    write_headings(fout);
+    ResultsFile rnd_t_results(name + "-rnd_t");  // put results into a CSV for later collation
     for (int depth = 1; depth <= MAX_DEPTH; depth++) {
         for (int trials = 1; trials <= TRIALS[depth]; trials++) {
             const std::string player_name = name + "-rnd_t(d=" + std::to_string(depth) + " t=" + std::to_string(trials) + ")";
@@ -138,48 +626,64 @@ void test_heuristic(const std::string& name, heuristic_t heuristic) {
             const int order = depth * 10 + trials;
             const int speed = order <= 21 ? 3 : (order <= 25 || order % 10 == 1 ? 2 : (order <= 33 ? 1 : 0));
 
-            test_player(fout, player_name, std::make_unique<RandomTrialsStrategy>(depth, trials, heuristic), GAMES[speed]);
+            test_player(rnd_t_results, player_name, std::make_unique<RandomTrialsStrategy>(depth, trials, heuristic), GAMES[speed]);
         }
     }
-    fout.close();
+    finish_tests();
+    rnd_t_results.close();
 
-    fout = std::ofstream("results/" + name + "-mnmx.csv");
-    write_headings(fout);
-    for (int depth = -1; depth <= MAX_DEPTH; depth++) {  // include depth=-1 and depth=0, which use depth picker
+    ResultsFile mnmx_results(name + "-mnmx");
+    // minimax has a cache and move ordering, so it goes one deeper than the other searches (d=6 takes less time than d=5 used to)
+    for (int depth = -1; depth <= MAX_DEPTH + 1; depth++) {  // include depth=-1 and depth=0, which use depth picker
         const std::string player_name = name + "-mnmx(d=" + std::to_string(depth) + ")";
-        const int speed = depth <= 0 || depth >= 4 ? 0 : 4 - depth;
-        test_player(fout, player_name, std::make_unique<MinimaxStrategy>(depth, heuristic), GAMES[speed]);
+        const int speed = depth <= 0 || depth >= 5 ? 0 : std::min(3, 5 - depth);
+        test_player(mnmx_results, player_name, std::make_unique<MinimaxStrategy>(depth, heuristic), GAMES[speed]);
     }
-    fout.close();
+    finish_tests();
+    mnmx_results.close();
 
-    fout = std::ofstream("results/" + name + "-expmx.csv");
-    write_headings(fout);
+    ResultsFile expmx_results(name + "-expmx");
 
     // include depth=-1 and depth=0, which uses depth picker; d=MAX_DEPTH will take too long
     for (int depth = -1; depth < MAX_DEPTH; depth++) {
         const std::string player_name = name + "-expmx(d=" + std::to_string(depth) + ")";
         const int speed = depth <= 0 || depth >= 4 ? 0 : 4 - depth;
-        test_player(fout, player_name, std::make_unique<ExpectimaxDepthStrategy>(depth, heuristic), GAMES[speed]);
+        auto player = std::make_unique<ExpectimaxDepthStrategy>(depth, heuristic, false, 1, CACHE_BYTES);
+#ifdef SAVE_CACHES
+        // holds onto the cache until it's saved, since the player gets destroyed once its games are done
+        // the cache is saved as soon as its games are done, so that only one depth's cache is in memory at a time
+        const std::string cache_file = "caches/" + player_name + ".ttc";
+        ExpectimaxDepthStrategy cache_owner(depth, heuristic, false, 1, CACHE_BYTES);
+        cache_owner.load_cache(cache_file);
+        player->share_cache(cache_owner);
+        test_player(expmx_results, player_name, std::move(player), GAMES[speed]);
+        finish_tests();
+        cache_owner.save_cache(cache_file);
+#else
+        if (SHARE_CACHE) player->share_cache();
+        test_player(expmx_results, player_name, std::move(player), GAMES[speed]);
+#endif
     }
     for (double prob = 0.1; prob >= 0.001; prob /= 10) {
         const int speed = (prob >= 0.1) + (prob >= 0.01) + (prob >= 0.001);
 
         std::string player_name = name + "-expmx(p=" + std::to_string(prob * 5) + ")";
-        test_player(fout, player_name, std::make_unique<ExpectimaxProbabilityStrategy>(prob * 5, heuristic), GAMES[speed]);
+        test_player(expmx_results, player_name, std::make_unique<ExpectimaxProbabilityStrategy>(prob * 5, heuristic), GAMES[speed]);
 
         player_name = name + "-expmx(p=" + std::to_string(prob) + ")";
-        test_player(fout, player_name, std::make_unique<ExpectimaxProbabilityStrategy>(prob, heuristic), GAMES[speed]);
+        test_player(expmx_results, player_name, std::make_unique<ExpectimaxProbabilityStrategy>(prob, heuristic), GAMES[speed]);
     }
-    fout.close();
+    finish_tests();
+    expmx_results.close();
 }
 
 void test_monte_carlo_strategy() {
-    std::ofstream fout("results/monte_carlo.csv");
-    write_headings(fout);
+    ResultsFile results("monte_carlo");
     for (int trials = 100; trials <= 2500; trials += 100) {
-        test_player(fout, "monte_carlo (t=" + std::to_string(trials) + ")", std::make_unique<MonteCarloPlayer>(trials), GAMES[0]);
+        test_player(results, "monte_carlo (t=" + std::to_string(trials) + ")", std::make_unique<MonteCarloPlayer>(trials), GAMES[0]);
     }
-    fout.close();
+    finish_tests();
+    results.close();
 }
 
 void run_board_echo() {
@@ -193,15 +697,15 @@ void run_board_echo() {
 int main() {
     //run_board_echo(); return 0;
 
-    //std::string record = "";
+    //TextRecord record;
     //const auto player = std::make_unique<ExpectimaxProbabilityStrategy>(0.0001, heuristics::corner_heuristic);
     //player->simulator.play_slow(*player, record);
     //return 0;
 
-    test_single_player("random", std::make_unique<RandomPlayer>(), GAMES[4]);
-    test_single_player("spam_corner", std::make_unique<SpamCornerPlayer>(), GAMES[4]);
-    test_single_player("ordered", std::make_unique<OrderedPlayer>(), GAMES[4]);
-    test_single_player("rotating", std::make_unique<RotatingPlayer>(), GAMES[4]);
+    test_batch_player<BatchRandomPolicy>("random", GAMES[4]);
+    test_batch_player<BatchSpamCornerPolicy>("spam_corner", GAMES[4]);
+    test_batch_player<BatchOrderedPolicy>("ordered", GAMES[4]);
+    test_batch_player<BatchRotatingPolicy>("rotating", GAMES[4]);
 
     test_heuristic("merge", heuristics::merge_heuristic);
     test_heuristic("score", heuristics::score_heuristic);
@@ -210,6 +714,10 @@ int main() {
     test_heuristic("wall_gap", heuristics::wall_gap_heuristic);
     test_monte_carlo_strategy();
 
+    //compare_players("corner-expmx(d=2)", std::make_unique<ExpectimaxDepthStrategy>(2, heuristics::corner_heuristic),
+    //                "wall_gap-expmx(d=2)", std::make_unique<ExpectimaxDepthStrategy>(2, heuristics::wall_gap_heuristic), GAMES[1]);
+
 
+    finish_tests();
     std::cout << "Done!" << std::endl;
 }
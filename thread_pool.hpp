@@ -0,0 +1,152 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing pool for splitting up a single search
+// every participant has its own queue: it pushes and pops its own tasks from the back (so it keeps working on the most
+// recent, and smallest, part of the tree) and steals from the front of other queues (which has the largest tasks)
+// slot 0 belongs to whichever outside thread is using the pool, and the pool starts threads - 1 workers for the other slots
+class ThreadPool {
+    using task_t = std::function<void()>;
+
+    struct Queue {
+        std::mutex lock;
+        std::deque<task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<int> pending{0};  // tasks sitting in any queue
+    std::atomic<int> sleeping{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    // which slot the current thread owns, if it's one of this pool's workers
+    static inline thread_local const ThreadPool* current_pool = nullptr;
+    static inline thread_local int current_slot = 0;
+
+    int slot() const {
+        return current_pool == this ? current_slot : 0;
+    }
+
+    bool pop_back(Queue& queue, task_t& task) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool pop_front(Queue& queue, task_t& task) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    void work(const int worker_slot) {
+        current_pool = this;
+        current_slot = worker_slot;
+        while (!stopping) {
+            if (run_one()) continue;
+
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            ++sleeping;
+            wake.wait(guard, [this] { return pending > 0 || stopping; });
+            --sleeping;
+        }
+    }
+
+public:
+    ThreadPool(const int threads) {
+        for (int i = 0; i < std::max(threads, 1); ++i) queues.push_back(std::make_unique<Queue>());
+        for (int i = 1; i < threads; ++i) workers.emplace_back(&ThreadPool::work, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker: workers) worker.join();
+    }
+
+    int size() const {
+        return queues.size();
+    }
+
+    void push(task_t task) {
+        Queue& queue = *queues[slot()];
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.tasks.push_back(std::move(task));
+        }
+        ++pending;
+        // a worker increments sleeping before checking pending, so it either sees this task or gets woken up
+        if (sleeping > 0) {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            wake.notify_one();
+        }
+    }
+
+    // runs a single task from the current thread's queue, or steals one if that's empty
+    // returns false if there was nothing to run
+    bool run_one() {
+        if (pending == 0) return false;
+
+        const int own = slot();
+        task_t task;
+        bool found = pop_back(*queues[own], task);
+        for (int i = 1; i < size() && !found; ++i) {
+            found = pop_front(*queues[(own + i) % size()], task);
+        }
+        if (!found) return false;
+
+        --pending;
+        task();
+        return true;
+    }
+};
+
+// a set of tasks that can be waited on together
+// waiting runs other tasks instead of blocking, so tasks can start their own groups without deadlocking the pool
+class TaskGroup {
+    ThreadPool& pool;
+    std::atomic<int> remaining{0};
+
+public:
+    TaskGroup(ThreadPool& _pool) : pool(_pool) {}
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    template<class Task>
+    void run(Task task) {
+        ++remaining;
+        pool.push([this, task] {
+            task();
+            --remaining;
+        });
+    }
+
+    void wait() {
+        while (remaining > 0) {
+            if (!pool.run_one()) std::this_thread::yield();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util.hpp"
+
+// fixed-size cache of search results, which replaces the hash map + deletion queue that expectimax used to have
+// entries are grouped into 64-byte buckets, so a lookup only ever touches a single cache line
+// nothing is ever erased: each search bumps a 4-bit generation, and old or shallow entries get overwritten first
+// several threads can share one table without any locks (see Entry), which the parallel expectimax search relies on
+// results can also be saved to a file, and later runs can look them up from there (see load and save)
+class TranspositionTable {
+    static constexpr int BUCKET_SIZE = 4;  // 4 entries of 16 bytes each
+
+    // tag holds the lower 54 bits of the board's hash, then the 2-bit variant, the 4-bit generation, and the 4-bit depth
+    // the bucket index comes from the top bits of the same hash, and the hash is a bijection,
+    // so as long as there are at least 2^10 buckets, a matching tag always means a matching board
+    // entries store tag ^ value instead of the tag, so if two threads write the same entry at the same time and it ends up
+    // with half of each write, the tag won't match and the entry is ignored (the XOR trick from Hyatt's Crafty)
+    // both halves are only ever read and written with relaxed atomics, which compile to plain loads and stores,
+    // so this costs nothing when only one thread uses the table
+    struct Entry {
+        uint64_t check;
+        uint64_t value;
+    };
+
+    struct alignas(64) Bucket {
+        Entry entries[BUCKET_SIZE];
+    };
+
+    static constexpr uint64_t KEY_MASK = ~0xFFULL;  // hash and variant
+    static constexpr int MIN_BUCKET_BITS = 10;
+
+    const int bucket_bits;
+
+    // nothing is allocated until the first search, and the memory comes from calloc,
+    // so that the OS can hand out zeroed pages as they get used instead of all of them up front
+    void* memory = nullptr;
+    Bucket* buckets = nullptr;  // memory, lined up with the start of a cache line
+
+    std::atomic<int> generation{0};
+
+    // a file of results that's mapped read-only, which probe checks whenever the board isn't in memory
+    // the file is a FileHeader followed by the buckets, in the same layout as in memory
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t bucket_bits;
+        char identity[112];  // everything that the results depend on, so that results from a different search never get used
+    };
+    static_assert(sizeof(FileHeader) % alignof(Bucket) == 0);
+
+    static constexpr char FILE_MAGIC[8] = "2048ttc";
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    const Bucket* saved_buckets = nullptr;
+    int saved_bucket_bits = 0;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    static uint64_t read(uint64_t& half) {
+        return std::atomic_ref<uint64_t>(half).load(std::memory_order_relaxed);
+    }
+
+    static void write(uint64_t& half, const uint64_t value) {
+        std::atomic_ref<uint64_t>(half).store(value, std::memory_order_relaxed);
+    }
+
+    // multiplying by an odd number is a bijection, and it mixes the lower tile bits into the top bits used for the index
+    static uint64_t hash(const board_t board) {
+        return board * 0x9E3779B97F4A7C15ULL;
+    }
+
+    Bucket& bucket_for(const uint64_t h) const {
+        assert(buckets != nullptr);  // new_search has to come first
+        return buckets[h >> (64 - bucket_bits)];
+    }
+
+    static uint64_t key(const uint64_t h, const int variant) {
+        return (h << 10) | (variant << 8);
+    }
+
+    // how many searches ago this entry was stored, counting the current search as 0
+    int age(const uint64_t tag) const {
+        return (generation.load(std::memory_order_relaxed) - static_cast<int>(tag >> 4)) & 0xF;
+    }
+
+public:
+    static constexpr size_t MIN_BYTES = sizeof(Bucket) << MIN_BUCKET_BITS;  // 64KB
+
+    // what store replaced, for SearchStats
+    enum class Replaced {
+        NOTHING, SAME_BOARD, OTHER_BOARD
+    };
+
+    // the table takes up the largest power of 2 number of bytes that's at most max_bytes (or MIN_BYTES if that's larger)
+    TranspositionTable(const size_t max_bytes) :
+            bucket_bits(std::bit_width(std::max(max_bytes, MIN_BYTES) / sizeof(Bucket)) - 1) {}
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    ~TranspositionTable() {
+        std::free(memory);
+        unload();
+    }
+
+    size_t size_bytes() const {
+        return sizeof(Bucket) << bucket_bits;
+    }
+
+    // new_search does this anyway, but a table that several threads share has to be allocated before any of them use it
+    void allocate() {
+        if (buckets != nullptr) return;
+
+        // calloc only promises 16-byte alignment, so there's an extra bucket of space to line the buckets up with
+        memory = std::calloc((1ULL << bucket_bits) + 1, sizeof(Bucket));
+        if (memory == nullptr) throw std::bad_alloc();
+        buckets = reinterpret_cast<Bucket*>((reinterpret_cast<uintptr_t>(memory) + alignof(Bucket) - 1) & ~(alignof(Bucket) - 1));
+    }
+
+    // gives the memory back, and the next search allocates it again
+    // nothing else can be using the table at the same time
+    void clear() {
+        std::free(memory);
+        memory = nullptr;
+        buckets = nullptr;
+        generation.store(0, std::memory_order_relaxed);
+    }
+
+    // call before each search so that entries from older searches get replaced first
+    // if several threads share the table, two searches starting at the same time might only bump the generation once,
+    // which just means that the older entries are kept around for slightly longer
+    void new_search() {
+        allocate();
+        generation.store((generation.load(std::memory_order_relaxed) + 1) & 0xF, std::memory_order_relaxed);
+    }
+
+    // depth 0 marks an empty entry, so only results with positive depth can be stored
+    // variant is 2 extra bits that have to match, for searches where the result depends on more than the board and depth
+    // if the board is both in memory and in the saved file, the deeper result wins, so that a shallow result in memory
+    // doesn't hide a deeper one that was saved
+    bool probe(const board_t board, eval_t& value, int& depth, const int variant = 0) {
+        const uint64_t h = hash(board);
+        Bucket& bucket = bucket_for(h);
+        const uint64_t board_key = key(h, variant);
+        bool hit = false;
+        for (Entry& entry : bucket.entries) {
+            // read the value once, since another thread could change it between the tag check and the copy
+            const uint64_t entry_value = read(entry.value);
+            const uint64_t tag = read(entry.check) ^ entry_value;
+            if ((tag & KEY_MASK) == board_key && (tag & 0xF) != 0) {
+                value = entry_value;
+                depth = tag & 0xF;
+                hit = true;
+                break;
+            }
+        }
+
+        if (saved_buckets == nullptr) return hit;
+        for (const Entry& entry : saved_buckets[h >> (64 - saved_bucket_bits)].entries) {
+            const uint64_t tag = entry.check ^ entry.value;  // nothing writes to the file, so these don't need to be atomic
+            if ((tag & KEY_MASK) == board_key && (tag & 0xF) != 0) {
+                if (!hit || depth < static_cast<int>(tag & 0xF)) {
+                    value = entry.value;
+                    depth = tag & 0xF;
+                }
+                return true;
+            }
+        }
+        return hit;
+    }
+
+    // overwrites the board's old entry if it has one; otherwise replaces the entry that's least useful,
+    // which is an empty entry if possible, and then prefers older and shallower entries
+    Replaced store(const board_t board, const eval_t value, const int depth, const int variant = 0) {
+        assert(0 < depth && depth < 16 && 0 <= variant && variant < 4);
+        const uint64_t h = hash(board);
+        Bucket& bucket = bucket_for(h);
+        const uint64_t board_key = key(h, variant);
+
+        Entry* replace = &bucket.entries[0];
+        uint64_t replace_tag = 0;
+        int replace_score = 1 << 30;
+        for (Entry& entry : bucket.entries) {
+            const uint64_t tag = read(entry.check) ^ read(entry.value);
+            if ((tag & KEY_MASK) == board_key || (tag & 0xF) == 0) {
+                replace = &entry;
+                replace_tag = tag;
+                break;
+            }
+            const int score = static_cast<int>(tag & 0xF) - 4 * age(tag);
+            if (replace_score > score) {
+                replace_score = score;
+                replace = &entry;
+                replace_tag = tag;
+            }
+        }
+
+        const uint64_t tag = board_key | (generation.load(std::memory_order_relaxed) << 4) | depth;
+        write(replace->check, tag ^ value);
+        write(replace->value, value);
+
+        if ((replace_tag & 0xF) == 0) return Replaced::NOTHING;
+        return (replace_tag & KEY_MASK) == board_key ? Replaced::SAME_BOARD : Replaced::OTHER_BOARD;
+    }
+
+    // maps a file written by save, as long as it was saved with the same identity
+    // the file is only read from, so new results still go into memory; call this before any searches start
+    bool load(const std::string& filename, const std::string& identity) {
+        unload();
+#ifdef HAS_MMAP
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) return false;
+        struct stat info;
+        const bool has_header = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(FileHeader);
+        void* file = has_header ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);  // the mapping stays valid without the file descriptor
+        if (file == MAP_FAILED) return false;
+
+        const FileHeader& header = *static_cast<const FileHeader*>(file);
+        const bool valid = std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 && header.version == FILE_VERSION &&
+                           MIN_BUCKET_BITS <= header.bucket_bits && header.bucket_bits < 40 &&
+                           static_cast<size_t>(info.st_size) == sizeof(FileHeader) + (sizeof(Bucket) << header.bucket_bits) &&
+                           std::strncmp(header.identity, identity.c_str(), sizeof(header.identity)) == 0;
+        if (!valid) {
+            munmap(file, info.st_size);
+            return false;
+        }
+
+        mapping = file;
+        mapping_size = info.st_size;
+        saved_buckets = reinterpret_cast<const Bucket*>(static_cast<const char*>(file) + sizeof(FileHeader));
+        saved_bucket_bits = header.bucket_bits;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void unload() {
+#ifdef HAS_MMAP
+        if (mapping != nullptr) munmap(mapping, mapping_size);
+#endif
+        mapping = nullptr;
+        saved_buckets = nullptr;
+    }
+
+    // writes every result from the loaded file, and every result in memory that looked at least min_depth moves ahead,
+    // into a file the size of this table; when there's too many for a bucket, the deepest ones are kept
+    // the file is written next to filename and then renamed over it, so tables that have the old file loaded keep working
+    // nothing else can be using the table at the same time
+    bool save(const std::string& filename, const std::string& identity, const int min_depth) {
+        FileHeader header{};
+        if (identity.size() >= sizeof(header.identity)) return false;
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FILE_VERSION;
+        header.bucket_bits = bucket_bits;
+        std::strcpy(header.identity, identity.c_str());
+
+        TranspositionTable merged(size_bytes());
+        merged.allocate();
+        if (saved_buckets != nullptr) {
+            for (size_t i = 0; i < (1ULL << saved_bucket_bits); ++i) {
+                for (const Entry& entry : saved_buckets[i].entries) {
+                    merged.keep_deepest(i, saved_bucket_bits, entry.check ^ entry.value, entry.value);
+                }
+            }
+        }
+        if (buckets != nullptr) {
+            for (size_t i = 0; i < (1ULL << bucket_bits); ++i) {
+                for (Entry& entry : buckets[i].entries) {
+                    const uint64_t tag = read(entry.check) ^ read(entry.value);
+                    if (static_cast<int>(tag & 0xF) >= min_depth) merged.keep_deepest(i, bucket_bits, tag, read(entry.value));
+                }
+            }
+        }
+
+        const std::string temp_filename = filename + ".tmp";
+        std::ofstream fout(temp_filename, std::ios::binary);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fout.write(reinterpret_cast<const char*>(merged.buckets), merged.size_bytes());
+        fout.close();
+        return fout.good() && std::rename(temp_filename.c_str(), filename.c_str()) == 0;
+    }
+
+private:
+    // adds an entry from bucket index of a table with table_bits bucket bits, unless the bucket has enough deeper entries
+    // the index has the top bits of the hash and the tag has the rest, so the entry can go into a table of a different size
+    void keep_deepest(const uint64_t index, const int table_bits, const uint64_t tag, const uint64_t value) {
+        const int depth = tag & 0xF;
+        if (depth == 0) return;
+
+        const uint64_t h = (index << (64 - table_bits)) | (tag >> 10);
+        const uint64_t board_key = tag & KEY_MASK;
+        Entry* replace = nullptr;
+        int replace_depth = depth;  // only shallower entries get replaced
+        for (Entry& entry : bucket_for(h).entries) {
+            const uint64_t old_tag = read(entry.check) ^ read(entry.value);
+            const int old_depth = old_tag & 0xF;
+            if ((old_tag & KEY_MASK) == board_key && old_depth != 0) {
+                if (old_depth > depth) return;
+                replace = &entry;
+                break;
+            }
+            if (old_depth < replace_depth) {
+                replace = &entry;
+                replace_depth = old_depth;
+            }
+        }
+        if (replace == nullptr) return;
+
+        const uint64_t new_tag = tag & ~0xF0ULL;  // the generation doesn't mean anything once it's saved
+        write(replace->check, new_tag ^ value);
+        write(replace->value, value);
+    }
+};
+
+#endif
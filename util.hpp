@@ -1,9 +1,16 @@
 #ifndef UTIL_HPP
 #define UTIL_HPP
 
+#include <bit>
 #include <chrono>
 #include <random>
 
+#include "tables.hpp"
+
+#ifdef __BMI2__
+#include <immintrin.h>  // pext and pdep; everything else uses std::popcount/std::countr_zero, which use popcnt/tzcnt when allowed
+#endif
+
 using row_t = uint16_t;
 using board_t = uint64_t;
 
@@ -14,7 +21,7 @@ static constexpr int ROWS = 0x10000;
 static constexpr row_t ROW_MASK = 0xFFFF;
 
 // precomputed array for reversing a row on the board
-consteval std::array<row_t, ROWS> generate_reversed() {
+TABLE_GENERATOR std::array<row_t, ROWS> generate_reversed() {
     std::array<row_t, ROWS> reversed;
     for (int row = 0; row < ROWS; ++row) {
         reversed[row] = ((row & 0xF) << 12) | (((row >> 4) & 0xF) << 8) | (((row >> 8) & 0xF) << 4) | (row >> 12);
@@ -22,17 +29,30 @@ consteval std::array<row_t, ROWS> generate_reversed() {
     return reversed;
 }
 
-constexpr std::array<row_t, ROWS> reversed = generate_reversed();
+LOOKUP_TABLE std::array<row_t, ROWS> reversed = generate_reversed();
+
+static constexpr board_t NIBBLE_LSB = 0x1111'1111'1111'1111ULL;  // lowest bit of every tile
+
+// sets the lowest bit of every tile that isn't empty, and clears everything else
+constexpr board_t nonempty_tiles(board_t board) {
+    board |= board >> 1;
+    board |= board >> 2;
+    return board & NIBBLE_LSB;
+}
 
 // bitmask of whether a tile is empty or not
 // more formally, converts a 64-bit integer (which has 16 bytes) into a 16-bit integer where
 // the n-th bit represents whether the n-th byte was nonzero
 uint16_t to_tile_mask(board_t mask) {
+#ifdef __BMI2__
+    return _pext_u64(nonempty_tiles(mask), NIBBLE_LSB);
+#else
     // inspired by https://stackoverflow.com/questions/34154745/efficient-way-to-or-adjacent-bits-in-64-bit-integer
     mask = (mask | (mask >>  1) | (mask >>  2) | (mask >>  3)) & 0x1111'1111'1111'1111ULL;
     mask = (mask | (mask >>  3) | (mask >>  6) | (mask >>  9)) & 0xF'000F'000F'000FULL;
     mask = (mask | (mask >> 12) | (mask >> 24) | (mask >> 36)) & 0xFFFF;
     return mask;
+#endif
 }
 
 // from https://github.com/nneonneo/2048-ai/blob/master/2048.cpp#L38-L48
@@ -40,7 +60,7 @@ uint16_t to_tile_mask(board_t mask) {
 //            4567    159d
 //            89ab    26ae
 //            cdef    37bf
-board_t transpose(const board_t board) {
+constexpr board_t transpose(const board_t board) {
     const board_t a = ((board & 0x0000F0F00000F0F0ULL) << 12) | ((board & 0xF0F00F0FF0F00F0FULL) | (board & 0x0F0F00000F0F0000ULL) >> 12);
     return ((a & 0x00000000FF00FF00ULL) << 24) | (a & 0xFF00FF0000FF00FFULL) | ((a & 0x00FF00FF00000000ULL) >> 24);
 }
@@ -63,6 +83,46 @@ board_t flip_v(const board_t board) {
              (board >> 48);
 }
 
+// the 8 symmetries of the board come from optionally flipping it horizontally, then vertically, and then transposing it
+// bit 0 of a transform is the horizontal flip, bit 1 is the vertical flip, and bit 2 is the transpose
+board_t apply_transform(board_t board, const int transform) {
+    if (transform & 1) board = flip_h(board);
+    if (transform & 2) board = flip_v(board);
+    if (transform & 4) board = transpose(board);
+    return board;
+}
+
+// the smallest of the board's 8 symmetries, which is the same for every board in the group
+// also sets transform so that apply_transform(board, transform) gives the canonical board
+board_t canonical_board(const board_t board, int& transform) {
+    const board_t h = flip_h(board);
+    const board_t v = flip_v(board);
+    const board_t symmetries[8] = {board, h, v, flip_v(h), transpose(board), transpose(h), transpose(v), transpose(flip_v(h))};
+
+    transform = 0;
+    for (int i = 1; i < 8; ++i) {
+        if (symmetries[transform] > symmetries[i]) transform = i;
+    }
+    return symmetries[transform];
+}
+
+// converts a move on the board into the matching move on apply_transform(board, transform)
+// a horizontal flip swaps left and right, a vertical flip swaps up and down, and a transpose swaps left with up and right with down
+int transform_move(int move, const int transform) {
+    if ((transform & 1) && (move & 1) == 0) move ^= 2;
+    if ((transform & 2) && (move & 1) == 1) move ^= 2;
+    if (transform & 4) move ^= 1;
+    return move;
+}
+
+// converts a move on apply_transform(board, transform) back into the matching move on the board
+int untransform_move(int move, const int transform) {
+    if (transform & 4) move ^= 1;
+    if ((transform & 2) && (move & 1) == 1) move ^= 2;
+    if ((transform & 1) && (move & 1) == 0) move ^= 2;
+    return move;
+}
+
 unsigned long long get_current_time_ms() {
     const std::chrono::time_point now = std::chrono::system_clock::now();
     const unsigned long long seconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
@@ -78,24 +138,39 @@ void print_board(const board_t board) {
     }
 }
 
+// finds the max one bit at a time, starting from the highest
+// candidates holds every tile that could still be the max, and only the candidates with the current bit set survive
 int get_max_tile(const board_t board) {
     int max_tile = 0;
-    for (int i = 0; i < 64; i += 4) max_tile = std::max(max_tile, (int)((board >> i) & 0xF));
+    board_t candidates = ~0ULL;
+    for (int bit = 3; bit >= 0; --bit) {
+        const board_t has_bit = (board & candidates) & (NIBBLE_LSB << bit);
+        if (has_bit != 0) {
+            max_tile |= 1 << bit;
+            candidates &= (has_bit >> bit) * 0xF;
+        }
+    }
     return max_tile;
 }
 
-// a somewhat understandable way to count set bits
-// https://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetKernighan
-int count_empty(uint16_t mask) {
-    int empty_ct;
-    for (empty_ct = 16; mask > 0; --empty_ct) {
-        mask &= mask - 1;
-    }
-    return empty_ct;
+// std::popcount becomes a single popcnt instruction when the CPU supports it
+int count_empty(const uint16_t mask) {
+    return 16 - std::popcount(mask);
+}
+
+// position (as a bit offset) of the k-th empty tile, counting up from the lowest tile
+int nth_empty_position(const board_t board, const int k) {
+    board_t empty = ~nonempty_tiles(board) & NIBBLE_LSB;
+#ifdef __BMI2__
+    return std::countr_zero(_pdep_u64(1ULL << k, empty));  // deposits the bit onto the k-th empty tile
+#else
+    for (int i = 0; i < k; ++i) empty &= empty - 1;  // drop the lowest k empty tiles
+    return std::countr_zero(empty);
+#endif
 }
 
 int count_set(const uint16_t mask) {
-    return 16 - count_empty(mask);
+    return std::popcount(mask);
 }
 
 int count_distinct_tiles(const board_t board) {
@@ -112,10 +187,6 @@ int board_sum(const board_t board) {
     return sum;
 }
 
-int count_fours(const std::string& record) {
-    return count_if(record.begin(), record.end(), isupper);
-}
-
 // every move, a 2 or 4 tile spawns, so we can calculate move count by board sum
 // the -2 is because the board starts with two tiles
 int count_moves_made(const board_t board, const int fours) {
@@ -126,13 +197,23 @@ int count_moves_made(const board_t board, const int fours) {
 // creating a tile of 2^n adds 2^n to the score, and requires two 2^(n-1) tiles
 // creating each of those added 2^(n-1) to the score, and following the recursive pattern gets n * 2^n
 // technically we want (n-1) * 2^n since the 2's spawning don't add to the score
-int approximate_score(const board_t board) {
-    int score = 0;
-    for (int i = 0; i < 64; i += 4) {
-        const uint8_t tile = (board >> i) & 0xF;
-        score += tile <= 1 ? 0 : (tile - 1) * (1 << tile);
+// score from making all the tiles in a row, assuming every tile spawned as a 2
+TABLE_GENERATOR std::array<int, ROWS> generate_row_scores() {
+    std::array<int, ROWS> row_scores;
+    for (int row = 0; row < ROWS; ++row) {
+        row_scores[row] = 0;
+        for (int i = 0; i < 16; i += 4) {
+            const int tile = (row >> i) & 0xF;
+            row_scores[row] += tile <= 1 ? 0 : (tile - 1) * (1 << tile);
+        }
     }
-    return score;
+    return row_scores;
+}
+
+LOOKUP_TABLE std::array<int, ROWS> row_scores = generate_row_scores();
+int approximate_score(const board_t board) {
+    return row_scores[board & 0xFFFF] + row_scores[(board >> 16) & 0xFFFF] +
+           row_scores[(board >> 32) & 0xFFFF] + row_scores[(board >> 48) & 0xFFFF];
 }
 
 int actual_score(const board_t board, const int fours) {